@@ -15,6 +15,10 @@ feed::feed(const std::shared_ptr<rapidxml::xml_document<>>& doc) {
     parse(*doc.get());
 }
 
+feed::feed(rapidxml::xml_document<>& doc) {
+  parse(doc);
+}
+
 feed::feed(const http::client::response& response) {
   std::string response_body = body(response);
   rapidxml::xml_document<> doc;
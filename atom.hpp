@@ -85,6 +85,7 @@ class feed {
 
   feed(const http::client::response& response);
   feed(const std::shared_ptr<rapidxml::xml_document<>>& doc);
+  explicit feed(rapidxml::xml_document<>& doc);
 
   std::string title() const { return title_; }
 
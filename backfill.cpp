@@ -0,0 +1,380 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "backfill.hpp"
+#include "rapidxml/rapidxml_utils.hpp"
+#include "xml_arena.hpp"
+#include <deque>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace {
+
+// files larger than this are mapped and split into batches by the
+// walker, smaller ones are read whole by a worker
+const size_t whole_file = 8 * 1024 * 1024;
+// the documents of a mapped archive are handed out this many bytes at a time
+const size_t batch_bytes = 1024 * 1024;
+// text is written to out once a worker has this much
+const size_t flush_bytes = 1024 * 1024;
+
+size_t find(const char* text, size_t size, size_t from, const char* pattern)
+{
+  size_t length = std::strlen(pattern);
+  const char* found = std::search(text + from, text + size, pattern, pattern + length);
+  return found - text;
+}
+
+bool starts(const char* text, size_t size, size_t at, const char* pattern)
+{
+  size_t length = std::strlen(pattern);
+  return size - at >= length && std::memcmp(text + at, pattern, length) == 0;
+}
+
+std::string system_error(const std::string& what, const std::string& path)
+{
+  return what + " " + path + ": " + std::strerror(errno);
+}
+
+// reads the file at path into buffer, replacing what it held
+void read_file(const std::string& path, std::vector<char>& buffer)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error(system_error("cannot open", path));
+  }
+  buffer.clear();
+  struct stat status;
+  if (::fstat(fd, &status) == 0) {
+    buffer.reserve(status.st_size + 1);
+  }
+  char chunk[64 * 1024];
+  for (;;) {
+    ssize_t got = ::read(fd, chunk, sizeof(chunk));
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got < 0) {
+      std::string error = system_error("cannot read", path);
+      ::close(fd);
+      throw std::runtime_error(error);
+    }
+    if (got == 0) {
+      break;
+    }
+    buffer.insert(buffer.end(), chunk, chunk + got);
+  }
+  ::close(fd);
+}
+
+}
+
+size_t next_document(const char* text, size_t size, size_t from)
+{
+  for (size_t at = from + 1; at < size; ++at) {
+    const void* open = std::memchr(text + at, '<', size - at);
+    if (!open) {
+      break;
+    }
+    at = static_cast<const char*>(open) - text;
+    if (starts(text, size, at, "<?xml") && at + 5 < size &&
+        (text[at + 5] == ' ' || text[at + 5] == '\t' || text[at + 5] == '\r' || text[at + 5] == '\n')) {
+      return at;
+    } else if (starts(text, size, at, "<!--")) {
+      at = find(text, size, at + 4, "-->");
+    } else if (starts(text, size, at, "<![CDATA[")) {
+      at = find(text, size, at + 9, "]]>");
+    }
+  }
+  return size;
+}
+
+// the work handed from the walker to the workers
+struct Backfill::Shared
+{
+  // a file to read whole, or documents of a mapped archive
+  struct Unit
+  {
+    Unit() : begin(0), end(0), first(0) {}
+    std::string path;
+    std::shared_ptr<rapidxml::mapped_file<>> archive;
+    size_t begin;
+    size_t end;
+    // the index in the archive of the document at begin
+    size_t first;
+  };
+
+  explicit Shared(size_t capacity) : capacity(capacity), closed(false) {}
+
+  void push(Unit unit)
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    space.wait(guard, [&]{ return units.size() < capacity; });
+    units.push_back(std::move(unit));
+    ready.notify_one();
+  }
+
+  // returns false once closed and empty
+  bool pop(Unit& unit)
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    ready.wait(guard, [&]{ return !units.empty() || closed; });
+    if (units.empty()) {
+      return false;
+    }
+    unit = std::move(units.front());
+    units.pop_front();
+    space.notify_one();
+    return true;
+  }
+
+  void close()
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    closed = true;
+    ready.notify_all();
+  }
+
+  const size_t capacity;
+  std::mutex lock;
+  std::condition_variable ready;
+  std::condition_variable space;
+  std::deque<Unit> units;
+  bool closed;
+
+  // serializes writes to out and the merging of stats
+  std::mutex output;
+  Stats stats;
+};
+
+Backfill::Backfill(size_t t, Extract e, std::ostream& o, Failed f)
+  : threads(t ? t : std::max(1u, std::thread::hardware_concurrency()))
+  , extract(std::move(e))
+  , failed(std::move(f))
+  , out(o)
+{
+}
+
+Backfill::Stats Backfill::run(const std::vector<std::string>& paths)
+{
+  auto start = clock::now();
+  Shared shared(threads * 4);
+
+  auto work = [&]{
+    // reused for every document this worker parses
+    std::vector<char> buffer;
+    std::unique_ptr<rapidxml::xml_document<>> doc(new rapidxml::xml_document<>());
+    doc->set_allocator(&xml_arena_alloc, &xml_arena_free);
+    std::string text;
+    Stats stats;
+
+    auto flush = [&]{
+      std::unique_lock<std::mutex> guard(shared.output);
+      out.write(text.data(), text.size());
+      text.clear();
+    };
+
+    Shared::Unit unit;
+    while (shared.pop(unit)) {
+      if (unit.archive) {
+        buffer.assign(unit.archive->data() + unit.begin, unit.archive->data() + unit.end);
+        if (unit.archive->truncated()) {
+          ++stats.failed;
+          if (failed) {
+            failed(unit.path, std::make_exception_ptr(std::runtime_error("the file shrank while it was read")));
+          }
+          continue;
+        }
+      } else {
+        try {
+          read_file(unit.path, buffer);
+        } catch (...) {
+          ++stats.failed;
+          if (failed) {
+            failed(unit.path, std::current_exception());
+          }
+          continue;
+        }
+        ++stats.files;
+        stats.bytes += buffer.size();
+      }
+      size_t size = buffer.size();
+      // room for the 0 after the last document
+      buffer.push_back(0);
+      size_t index = unit.first;
+      for (size_t begin = 0; begin < size; ++index) {
+        size_t end = next_document(buffer.data(), size, begin);
+        // the document is parsed in place and ended with a 0 for the
+        // parse, the next one starts with the byte it displaces
+        char next = buffer[end];
+        buffer[end] = 0;
+        std::string source = index == 0 ? unit.path : unit.path + "#" + std::to_string(index);
+        size_t extracted = text.size();
+        try {
+          doc->recycle();
+          doc->parse<0>(buffer.data() + begin);
+          stats.items += extract(source, *doc, text);
+          ++stats.documents;
+        } catch (...) {
+          text.resize(extracted);
+          ++stats.failed;
+          if (failed) {
+            failed(source, std::current_exception());
+          }
+        }
+        buffer[end] = next;
+        begin = end;
+        if (text.size() >= flush_bytes) {
+          flush();
+        }
+      }
+    }
+    doc->clear();
+    flush();
+    std::unique_lock<std::mutex> guard(shared.output);
+    shared.stats.files += stats.files;
+    shared.stats.documents += stats.documents;
+    shared.stats.failed += stats.failed;
+    shared.stats.items += stats.items;
+    shared.stats.bytes += stats.bytes;
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t worker = 0; worker < threads; ++worker) {
+    workers.emplace_back(work);
+  }
+
+  // hands out the file at path, in batches of documents when it is large
+  size_t archived = 0;
+  size_t archivedBytes = 0;
+  auto walkFile = [&](const std::string& path, size_t size) {
+    Shared::Unit unit;
+    unit.path = path;
+    if (size <= whole_file) {
+      shared.push(std::move(unit));
+      return;
+    }
+    unit.archive = std::make_shared<rapidxml::mapped_file<>>(path.c_str());
+    ++archived;
+    archivedBytes += size;
+    const char* text = unit.archive->data();
+    size_t index = 0;
+    for (size_t begin = 0; begin < size;) {
+      Shared::Unit batch = unit;
+      batch.begin = begin;
+      batch.first = index;
+      do {
+        begin = next_document(text, size, begin);
+        ++index;
+      } while (begin < size && begin - batch.begin < batch_bytes);
+      batch.end = begin;
+      shared.push(std::move(batch));
+    }
+  };
+
+  // a path that cannot be walked is reported like a document that fails,
+  // and the walk goes on
+  size_t unwalked = 0;
+  auto skip = [&](const std::string& path, std::exception_ptr error) {
+    ++unwalked;
+    if (failed) {
+      failed(path, error);
+    }
+  };
+
+  // symbolic links are followed, a directory reached again through one
+  // is not walked twice, nor is a link back up the tree followed round
+  std::set<std::pair<dev_t, ino_t>> visited;
+  std::function<void(const std::string&)> walk = [&](const std::string& path) {
+    struct stat status;
+    if (::stat(path.c_str(), &status) != 0) {
+      return skip(path, std::make_exception_ptr(std::runtime_error(system_error("cannot stat", path))));
+    }
+    if (S_ISREG(status.st_mode)) {
+      try {
+        walkFile(path, status.st_size);
+      } catch (const std::runtime_error&) {
+        return skip(path, std::current_exception());
+      }
+      return;
+    }
+    if (!S_ISDIR(status.st_mode)) {
+      return;
+    }
+    if (!visited.insert(std::make_pair(status.st_dev, status.st_ino)).second) {
+      return;
+    }
+    DIR* dir = ::opendir(path.c_str());
+    if (!dir) {
+      return skip(path, std::make_exception_ptr(std::runtime_error(system_error("cannot open", path))));
+    }
+    std::vector<std::string> names;
+    while (dirent* entry = ::readdir(dir)) {
+      if (std::strcmp(entry->d_name, ".") != 0 && std::strcmp(entry->d_name, "..") != 0) {
+        names.push_back(entry->d_name);
+      }
+    }
+    ::closedir(dir);
+    // in a stable order, so that runs over the same corpus compare
+    std::sort(names.begin(), names.end());
+    std::string prefix = path.empty() || path.back() == '/' ? path : path + "/";
+    for (auto& name : names) {
+      walk(prefix + name);
+    }
+  };
+
+  std::exception_ptr error;
+  try {
+    for (auto& path : paths) {
+      walk(path);
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+  shared.close();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  out.flush();
+
+  shared.stats.failed += unwalked;
+  shared.stats.files += archived;
+  shared.stats.bytes += archivedBytes;
+  shared.stats.elapsed = clock::now() - start;
+  return shared.stats;
+}
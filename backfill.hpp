@@ -0,0 +1,93 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___BACKFILL_INC__
+#define ___BACKFILL_INC__
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <ostream>
+#include "rapidxml/rapidxml.hpp"
+
+// returns the offset of the next document in an archive of documents
+// concatenated one after another, text[0, size), after the one that
+// starts at from. a document starts at its xml declaration, those
+// within comments or CDATA sections are passed over. returns size when
+// there are no more. a file without declarations is one document.
+size_t next_document(const char* text, size_t size, size_t from);
+
+// runs extraction over archived feed documents rather than polling. the
+// paths are files, or directories walked recursively, and each file is
+// an archive of one or more documents. the documents are parsed in
+// parallel, each worker reusing one buffer and one xml_document for all
+// of them, and the text extracted is written to out in large blocks.
+class Backfill
+{
+public:
+  typedef std::chrono::steady_clock clock;
+
+  struct Stats
+  {
+    Stats() : files(0), documents(0), failed(0), items(0), bytes(0), elapsed(0) {}
+    size_t files;
+    // parsed and extracted, and not
+    size_t documents;
+    size_t failed;
+    size_t items;
+    // of the files read
+    size_t bytes;
+    clock::duration elapsed;
+  };
+
+  // appends the text for the items of doc to out and returns how many
+  // there were. source names the document, "path" or "path#index" for
+  // the documents after the first in an archive. throws when doc is
+  // not understood.
+  typedef std::function<size_t(const std::string& source, rapidxml::xml_document<>& doc, std::string& out)> Extract;
+  // a document that failed to parse or extract, or a path that could not
+  // be walked. like extract, it is called on the worker threads, and for
+  // a path on the thread calling run, so at the same time as on them.
+  typedef std::function<void(const std::string& source, const std::exception_ptr& error)> Failed;
+
+  // a threads of zero is one per core
+  Backfill(size_t threads, Extract extract, std::ostream& out, Failed failed = Failed());
+
+  // returns once every document under paths has been through extract.
+  // throws when a path cannot be read.
+  Stats run(const std::vector<std::string>& paths);
+
+private:
+  Backfill(const Backfill&);
+  Backfill& operator=(const Backfill&);
+
+  struct Shared;
+
+  size_t threads;
+  Extract extract;
+  Failed failed;
+  std::ostream& out;
+};
+
+#endif  // ___BACKFILL_INC__
@@ -0,0 +1,172 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "connection_pool.hpp"
+#include "fetch_queue.hpp"
+
+ConnectionPool::Lease::Lease(std::shared_ptr<ConnectionPool> pool, std::string host, std::shared_ptr<client_type> client)
+  : pool_(std::move(pool))
+  , host_(std::move(host))
+  , client_(std::move(client))
+{}
+
+ConnectionPool::Lease::Lease(Lease&& other)
+  : pool_(std::move(other.pool_))
+  , host_(std::move(other.host_))
+  , client_(std::move(other.client_))
+  , discard_(other.discard_)
+{}
+
+ConnectionPool::Lease& ConnectionPool::Lease::operator=(Lease&& other)
+{
+  if (this != &other) {
+    release();
+    pool_ = std::move(other.pool_);
+    host_ = std::move(other.host_);
+    client_ = std::move(other.client_);
+    discard_ = other.discard_;
+  }
+  return *this;
+}
+
+ConnectionPool::Lease::~Lease()
+{
+  release();
+}
+
+void ConnectionPool::Lease::release()
+{
+  if (pool_ && client_) {
+    pool_->release(host_, std::move(client_), discard_);
+  }
+  pool_.reset();
+  client_.reset();
+}
+
+ConnectionPool::ConnectionPool(ConnectionLimits l)
+  : limits(l)
+{
+  if (limits.max_per_host == 0) {
+    limits.max_per_host = 1;
+  }
+}
+
+ConnectionPool::Lease ConnectionPool::acquire(const std::string& uri, std::chrono::steady_clock::time_point deadline)
+{
+  std::string key = host_key(uri);
+  std::unique_lock<std::mutex> guard(lock);
+  bool waited = false;
+  for (;;) {
+    // a waiting host is not removed by prune()
+    Host& host = hosts[key];
+    auto now = std::chrono::steady_clock::now();
+    prune(host, now);
+    bool room = !host.idle.empty() || host.open < limits.max_per_host;
+    if (waited && (room || now >= deadline)) {
+      --host.waiting;
+    }
+    if (!host.idle.empty()) {
+      // most recently used first, it is the least likely to have been
+      // closed by the server
+      auto client = std::move(host.idle.back().client);
+      host.idle.pop_back();
+      ++counters.hits;
+      return Lease(shared_from_this(), key, std::move(client));
+    }
+    if (room) {
+      ++host.open;
+      break;
+    }
+    if (now >= deadline || (!waited && host.waiting >= limits.max_per_host)) {
+      ++counters.gave_up;
+      return Lease();
+    }
+    if (!waited) {
+      ++host.waiting;
+      waited = true;
+    }
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+      released.wait(guard);
+    } else {
+      released.wait_until(guard, deadline);
+    }
+  }
+  ++counters.misses;
+  guard.unlock();
+
+  std::shared_ptr<client_type> client;
+  try {
+    client = std::make_shared<client_type>();
+  } catch (...) {
+    guard.lock();
+    --hosts[key].open;
+    released.notify_all();
+    throw;
+  }
+  return Lease(shared_from_this(), key, std::move(client));
+}
+
+void ConnectionPool::release(const std::string& key, std::shared_ptr<client_type> client, bool discard)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  Host& host = hosts[key];
+  if (discard) {
+    --host.open;
+    ++counters.discarded;
+  } else {
+    Idle idle;
+    idle.client = std::move(client);
+    idle.since = std::chrono::steady_clock::now();
+    host.idle.push_back(std::move(idle));
+  }
+  released.notify_all();
+}
+
+void ConnectionPool::prune(Host& host, std::chrono::steady_clock::time_point now)
+{
+  while (!host.idle.empty() && now - host.idle.front().since > limits.idle_timeout) {
+    host.idle.pop_front();
+    --host.open;
+    ++counters.expired;
+  }
+}
+
+void ConnectionPool::prune()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto now = std::chrono::steady_clock::now();
+  for (auto cursor = hosts.begin(); cursor != hosts.end();) {
+    prune(cursor->second, now);
+    if (cursor->second.open == 0 && cursor->second.waiting == 0) {
+      cursor = hosts.erase(cursor);
+    } else {
+      ++cursor;
+    }
+  }
+  released.notify_all();
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return counters;
+}
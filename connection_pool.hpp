@@ -0,0 +1,142 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___CONNECTION_POOL_INC__
+#define ___CONNECTION_POOL_INC__
+
+#include <string>
+#include <map>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <network/http/client.hpp>
+
+struct ConnectionLimits
+{
+  ConnectionLimits() : max_per_host(2), idle_timeout(std::chrono::seconds(30)) {}
+  // most connections open to a single scheme://host:port, idle or in use
+  size_t max_per_host;
+  // idle connections older than this are closed rather than reused
+  std::chrono::steady_clock::duration idle_timeout;
+};
+
+// keeps one network::http::client per keep-alive connection, keyed by
+// host_key(uri). a client is leased for a single request and returned
+// to the idle list when the lease is destroyed, so the connection it
+// holds open is reused by the next request to that host.
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool>
+{
+public:
+  typedef network::http::client client_type;
+
+  struct Stats
+  {
+    Stats() : hits(0), misses(0), expired(0), discarded(0), gave_up(0) {}
+    // requests served by an idle connection
+    size_t hits;
+    // requests that needed a new client. the client connects, and
+    // reconnects after the server closes, inside netlib, which does not
+    // report either, so this is not a count of connects or handshakes.
+    size_t misses;
+    // idle connections closed by the idle timeout
+    size_t expired;
+    // connections dropped after a failed request
+    size_t discarded;
+    // acquires that returned no lease, at their deadline or because
+    // max_per_host others were already waiting for the host
+    size_t gave_up;
+  };
+
+  class Lease
+  {
+  public:
+    Lease() {}
+    Lease(Lease&& other);
+    Lease& operator=(Lease&& other);
+    ~Lease();
+
+    client_type& client() const { return *client_; }
+
+    // false for the lease of an acquire() that gave up
+    explicit operator bool() const { return !!client_; }
+
+    // the connection failed, do not return it to the pool
+    void discard() { discard_ = true; }
+
+  private:
+    friend class ConnectionPool;
+    Lease(std::shared_ptr<ConnectionPool> pool, std::string host, std::shared_ptr<client_type> client);
+    Lease(const Lease&);
+    Lease& operator=(const Lease&);
+    void release();
+
+    std::shared_ptr<ConnectionPool> pool_;
+    std::string host_;
+    std::shared_ptr<client_type> client_;
+    bool discard_ = false;
+  };
+
+  explicit ConnectionPool(ConnectionLimits limits);
+
+  // blocks while the host of uri is at max_per_host connections in use,
+  // until deadline. returns an empty lease at the deadline, or at once
+  // when max_per_host others are waiting already. a request that hangs
+  // holds its connection, so the requests waiting behind hung ones give
+  // up rather than piling up on the host.
+  Lease acquire(
+    const std::string& uri,
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+  // close idle connections that have passed the idle timeout.
+  void prune();
+
+  Stats stats() const;
+
+private:
+  struct Idle
+  {
+    std::shared_ptr<client_type> client;
+    std::chrono::steady_clock::time_point since;
+  };
+  struct Host
+  {
+    Host() : open(0), waiting(0) {}
+    size_t open;
+    // acquires blocked on max_per_host
+    size_t waiting;
+    std::deque<Idle> idle;
+  };
+
+  void release(const std::string& host, std::shared_ptr<client_type> client, bool discard);
+  void prune(Host& host, std::chrono::steady_clock::time_point now);
+
+  ConnectionLimits limits;
+  mutable std::mutex lock;
+  std::condition_variable released;
+  std::map<std::string, Host> hosts;
+  Stats counters;
+};
+
+#endif  // ___CONNECTION_POOL_INC__
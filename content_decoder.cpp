@@ -0,0 +1,174 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "content_decoder.hpp"
+#include <zlib.h>
+#include <algorithm>
+#include <stdexcept>
+#include <cctype>
+
+const char* const accept_encoding = "gzip, deflate";
+
+namespace {
+std::string lowercase(std::string value)
+{
+  std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+  return value;
+}
+}
+
+bool is_decodable(const std::string& contentEncoding)
+{
+  auto encoding = lowercase(contentEncoding);
+  return encoding == "gzip" || encoding == "x-gzip" || encoding == "deflate";
+}
+
+struct ContentDecoder::Stream
+{
+  Stream() : initialized(false) { z = z_stream(); }
+  ~Stream() {
+    if (initialized)
+      inflateEnd(&z);
+  }
+  z_stream z;
+  bool initialized;
+};
+
+ContentDecoder::ContentDecoder(const std::string& ce, size_t md)
+  : stream(new Stream())
+  , contentEncoding(lowercase(ce))
+  , max_decoded(md)
+  , encoded(0)
+  , started(false)
+  , ended(false)
+{
+  if (!is_decodable(contentEncoding)) {
+    throw std::invalid_argument("unsupported Content-Encoding: " + ce);
+  }
+}
+
+ContentDecoder::~ContentDecoder()
+{
+}
+
+void ContentDecoder::init(int windowBits)
+{
+  if (inflateInit2(&stream->z, windowBits) != Z_OK) {
+    throw std::runtime_error("inflateInit2 failed");
+  }
+  stream->initialized = true;
+}
+
+void ContentDecoder::write(const char* data, size_t size)
+{
+  if (size == 0) {
+    return;
+  }
+  if (!started) {
+    if (contentEncoding == "deflate") {
+      if (head.empty() && size == 1) {
+        head.assign(data, size);
+        return;
+      }
+      // "deflate" is meant to be zlib wrapped, but some servers send raw
+      // deflate. a zlib header has method 8 and a checksum divisible by 31.
+      unsigned char cmf = static_cast<unsigned char>(head.empty() ? data[0] : head[0]);
+      unsigned char flg = static_cast<unsigned char>(head.empty() ? data[1] : data[0]);
+      bool zlib = (cmf & 0x0f) == 8 && ((cmf << 8) | flg) % 31 == 0;
+      init(zlib ? MAX_WBITS : -MAX_WBITS);
+    } else {
+      init(MAX_WBITS + 16);
+    }
+    started = true;
+  }
+  if (!head.empty()) {
+    std::string held;
+    held.swap(head);
+    inflate(held.data(), held.size());
+  }
+  inflate(data, size);
+}
+
+void ContentDecoder::inflate(const char* data, size_t size)
+{
+  if (ended) {
+    // trailing garbage after the end of the stream is ignored
+    encoded += size;
+    return;
+  }
+
+  const size_t chunk = 16 * 1024;
+  z_stream& z = stream->z;
+  z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  z.avail_in = static_cast<uInt>(size);
+  encoded += size;
+  while (z.avail_in > 0 && !ended) {
+    size_t offset = decoded.size();
+    // one byte past the limit, to tell a body that passes it
+    size_t left = max_decoded - std::min(max_decoded, offset);
+    size_t room = left < chunk ? left + 1 : chunk;
+    decoded.resize(offset + room);
+    z.next_out = reinterpret_cast<Bytef*>(&decoded[offset]);
+    z.avail_out = static_cast<uInt>(room);
+    int result = ::inflate(&z, Z_NO_FLUSH);
+    decoded.resize(offset + room - z.avail_out);
+    if (decoded.size() > max_decoded) {
+      throw std::length_error("decoded body is larger than the limit");
+    }
+    if (result == Z_STREAM_END) {
+      ended = true;
+    } else if (result == Z_BUF_ERROR && z.avail_out != 0) {
+      break;
+    } else if (result != Z_OK && result != Z_BUF_ERROR) {
+      throw std::runtime_error(std::string("corrupt ") + contentEncoding + " body: " + (z.msg ? z.msg : "inflate failed"));
+    }
+  }
+}
+
+std::string& ContentDecoder::finish()
+{
+  if ((started && !ended) || !head.empty()) {
+    throw std::runtime_error("truncated " + contentEncoding + " body");
+  }
+  return decoded;
+}
+
+void TransferStats::record(const std::string& uri, size_t wire, size_t decoded)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  Transfer& transfer = transfers[uri];
+  ++transfer.responses;
+  transfer.wire += wire;
+  transfer.decoded += decoded;
+}
+
+void TransferStats::forget(const std::string& uri)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  transfers.erase(uri);
+}
+
+TransferStats::Feeds TransferStats::feeds() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return transfers;
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___CONTENT_DECODER_INC__
+#define ___CONTENT_DECODER_INC__
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// the Accept-Encoding sent with each request
+extern const char* const accept_encoding;
+
+// returns true for the Content-Encoding values ContentDecoder supports
+bool is_decodable(const std::string& contentEncoding);
+
+// decodes a gzip or deflate body incrementally, as the encoded bytes
+// are written. throws std::length_error once the decoded size would
+// pass max_decoded and std::runtime_error for a corrupt stream.
+class ContentDecoder
+{
+public:
+  ContentDecoder(const std::string& contentEncoding, size_t max_decoded);
+  ~ContentDecoder();
+
+  void write(const char* data, size_t size);
+
+  // verifies that the stream ended and returns the decoded bytes
+  std::string& finish();
+
+  // the bytes decoded so far
+  const std::string& output() const { return decoded; }
+
+  size_t encoded_size() const { return encoded; }
+  size_t decoded_size() const { return decoded.size(); }
+
+private:
+  ContentDecoder(const ContentDecoder&);
+  ContentDecoder& operator=(const ContentDecoder&);
+
+  void init(int windowBits);
+  void inflate(const char* data, size_t size);
+
+  struct Stream;
+  std::unique_ptr<Stream> stream;
+  std::string contentEncoding;
+  size_t max_decoded;
+  size_t encoded;
+  bool started;
+  bool ended;
+  // the first byte of a deflate body, held until the second tells how
+  // it is wrapped
+  std::string head;
+  std::string decoded;
+};
+
+// bytes on the wire and after decoding, per feed
+class TransferStats
+{
+public:
+  struct Transfer
+  {
+    Transfer() : responses(0), wire(0), decoded(0) {}
+    size_t responses;
+    size_t wire;
+    size_t decoded;
+  };
+  typedef std::map<std::string, Transfer> Feeds;
+
+  void record(const std::string& uri, size_t wire, size_t decoded);
+
+  // drops what was recorded for uri, e.g. a feed no longer polled
+  void forget(const std::string& uri);
+
+  Feeds feeds() const;
+
+private:
+  mutable std::mutex lock;
+  Feeds transfers;
+};
+
+#endif  // ___CONTENT_DECODER_INC__
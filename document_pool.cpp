@@ -0,0 +1,158 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "document_pool.hpp"
+#include "xml_arena.hpp"
+#include "poll_schedule.hpp"
+#include <algorithm>
+
+namespace {
+
+// the largest block, a feed bigger than this takes several
+const size_t max_block_size = 64 * 1024 * 1024;
+const size_t min_block_size = 4 * 1024;
+// the headers of rapidxml and the arena, taken off the size of a block
+// so that a block with them fills whole pages
+const size_t block_overhead = 64;
+
+void* counted_alloc(std::size_t size)
+{
+  ++document_pool_counters().blocks;
+  document_pool_counters().block_bytes += size;
+  return xml_arena_alloc(size);
+}
+
+}
+
+void DocumentPool::Return::operator()(rapidxml::xml_document<>* doc) const
+{
+  pool->release(doc);
+}
+
+DocumentPool::DocumentPool(size_t i, size_t r)
+  : max_idle(i)
+  , retained(r)
+{
+  // so that release does not allocate
+  documents.reserve(max_idle);
+}
+
+DocumentPool::~DocumentPool()
+{
+  for (auto doc : documents) {
+    delete doc;
+  }
+}
+
+DocumentPool::Document DocumentPool::acquire(size_t block_size)
+{
+  ++document_pool_counters().acquired;
+  rapidxml::xml_document<>* doc = nullptr;
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    if (!documents.empty()) {
+      doc = documents.back();
+      documents.pop_back();
+    }
+  }
+  if (!doc) {
+    ++document_pool_counters().created;
+    doc = new rapidxml::xml_document<>();
+    doc->set_allocator(&counted_alloc, &xml_arena_free);
+  }
+  doc->set_block_size(block_size);
+  Return back;
+  back.pool = shared_from_this();
+  return Document(doc, std::move(back));
+}
+
+size_t DocumentPool::idle() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return documents.size();
+}
+
+void DocumentPool::release(rapidxml::xml_document<>* doc)
+{
+  // outside the lock, the blocks of a large document take a while
+  if (doc->dynamic_size() > retained) {
+    doc->clear();
+  } else {
+    doc->recycle();
+  }
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    if (documents.size() < max_idle) {
+      documents.push_back(doc);
+      return;
+    }
+  }
+  delete doc;
+}
+
+DocumentSizing::DocumentSizing(std::shared_ptr<PollSchedule> s, double ratio)
+  : schedule(std::move(s))
+  , overall(ratio)
+{
+}
+
+size_t DocumentSizing::block_size(const std::string& uri, size_t text) const
+{
+  double ratio = schedule ? schedule->node_ratio(uri) : 0;
+  if (ratio == 0) {
+    ratio = overall;
+  }
+  // an eighth more, so that a feed that grows a little still fits
+  double estimate = ratio * text * 1.125;
+  size_t needed = estimate > RAPIDXML_STATIC_POOL_SIZE ? static_cast<size_t>(estimate) - RAPIDXML_STATIC_POOL_SIZE : 0;
+  needed += block_overhead;
+  // four sizes to each doubling, in whole pages
+  size_t size = min_block_size;
+  size_t step = min_block_size;
+  while (size < needed && size < max_block_size) {
+    size += step;
+    if (size == 8 * step) {
+      step *= 2;
+    }
+  }
+  return size - block_overhead;
+}
+
+void DocumentSizing::parsed(const std::string& uri, size_t text, const rapidxml::xml_document<>& doc)
+{
+  if (text == 0) {
+    return;
+  }
+  double ratio = static_cast<double>(doc.allocated_size()) / text;
+  if (schedule) {
+    double learned = schedule->node_ratio(uri);
+    schedule->set_node_ratio(uri, learned == 0 ? ratio : (learned + ratio) / 2);
+  }
+  overall += (ratio - overall) / 16;
+}
+
+DocumentPoolCounters& document_pool_counters()
+{
+  static DocumentPoolCounters counters;
+  return counters;
+}
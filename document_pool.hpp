@@ -0,0 +1,113 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___DOCUMENT_POOL_INC__
+#define ___DOCUMENT_POOL_INC__
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "rapidxml/rapidxml.hpp"
+
+class PollSchedule;
+
+// the documents of one parse worker. a document acquired goes back to
+// the pool when its handle is destroyed, on whichever thread that is,
+// and is recycled, so that the next feed parsed in it allocates its
+// nodes from the dynamic blocks of the last rather than fresh ones.
+class DocumentPool : public std::enable_shared_from_this<DocumentPool>
+{
+public:
+  struct Return
+  {
+    std::shared_ptr<DocumentPool> pool;
+    void operator()(rapidxml::xml_document<>* doc) const;
+  };
+  typedef std::unique_ptr<rapidxml::xml_document<>, Return> Document;
+
+  // keeps up to idle documents, and the blocks of those that held no
+  // more than retained bytes of dynamic memory. the documents that held
+  // more are cleared, so that one huge feed does not pin its memory.
+  explicit DocumentPool(size_t idle = 4, size_t retained = 4 * 1024 * 1024);
+  ~DocumentPool();
+
+  // an empty document that allocates dynamic blocks of block_size
+  // bytes, or the default size for 0. the pool must be held by a
+  // shared_ptr.
+  Document acquire(size_t block_size = 0);
+
+  size_t idle() const;
+
+private:
+  DocumentPool(const DocumentPool&);
+  DocumentPool& operator=(const DocumentPool&);
+
+  void release(rapidxml::xml_document<>* doc);
+
+  mutable std::mutex lock;
+  std::vector<rapidxml::xml_document<>*> documents;
+  size_t max_idle;
+  size_t retained;
+};
+
+// picks the size of the dynamic blocks of a document from the length
+// of the text of the feed to be parsed into it, so that a small feed
+// fits in the static pool of the document or one small block and a
+// huge feed allocates a few large blocks. the sizes grow geometrically,
+// four to each doubling, so the blocks of all feeds fall in a few page
+// classes of the arena and a block one feed frees is reused by the next. the bytes of nodes
+// per byte of text are learned for each feed and kept in schedule with
+// the rest of its state, and for all of them to size a feed that has
+// not been parsed yet. used by one parse worker.
+class DocumentSizing
+{
+public:
+  explicit DocumentSizing(std::shared_ptr<PollSchedule> schedule = nullptr, double ratio = 3.0);
+
+  size_t block_size(const std::string& uri, size_t text) const;
+
+  // learns from doc, just parsed from text bytes of the feed at uri
+  void parsed(const std::string& uri, size_t text, const rapidxml::xml_document<>& doc);
+
+private:
+  std::shared_ptr<PollSchedule> schedule;
+  double overall;
+};
+
+// counts across all the pools. blocks are the dynamic blocks allocated
+// by the memory pools of their documents from the xml arena, a recycled
+// document reuses its blocks without counting them again.
+struct DocumentPoolCounters
+{
+  DocumentPoolCounters() : acquired(0), created(0), blocks(0), block_bytes(0) {}
+  std::atomic<size_t> acquired;
+  std::atomic<size_t> created;
+  std::atomic<size_t> blocks;
+  std::atomic<size_t> block_bytes;
+};
+
+DocumentPoolCounters& document_pool_counters();
+
+#endif  // ___DOCUMENT_POOL_INC__
@@ -0,0 +1,269 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "entry_scanner.hpp"
+#include "feed_stream.hpp"
+
+namespace {
+
+bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+}  // namespace
+
+EntryScanner::EntryScanner()
+  : position(0)
+  , entry(std::string::npos)
+  , entryStart(0)
+  , atom(false)
+  , identified(false)
+  , capture(none)
+  , count(0)
+  , stop(std::string::npos)
+{
+}
+
+bool EntryScanner::report(const std::string& value, const Found& found)
+{
+  if (value.empty() || found(value)) {
+    return true;
+  }
+  stop = entryStart;
+  openAtStop.assign(open.begin(), open.begin() + entry);
+  return false;
+}
+
+bool EntryScanner::scan(const std::string& text, const Found& found)
+{
+  if (stopped()) {
+    return false;
+  }
+  while (position < text.size()) {
+    size_t markup = text.find('<', position);
+    if (markup == std::string::npos) {
+      // character data being captured is kept until its end is known,
+      // it might end in the middle of a reference
+      if (capture == none) {
+        position = text.size();
+      }
+      return true;
+    }
+    if (capture != none) {
+      append_xml_text(captured, text.data() + position, text.data() + markup);
+    }
+    position = markup;
+    // the longest prefix told apart below is "<![CDATA["
+    if (text.size() - position < 9) {
+      return true;
+    }
+    if (text.compare(position, 4, "<!--") == 0) {
+      size_t end = text.find("-->", position + 4);
+      if (end == std::string::npos) {
+        return true;
+      }
+      position = end + 3;
+      continue;
+    }
+    if (text.compare(position, 9, "<![CDATA[") == 0) {
+      size_t end = text.find("]]>", position + 9);
+      if (end == std::string::npos) {
+        return true;
+      }
+      if (capture != none) {
+        captured.append(text, position + 9, end - position - 9);
+      }
+      position = end + 3;
+      continue;
+    }
+
+    // the end of the tag, past any '>' in quoted attribute values
+    size_t close = position + 1;
+    char quote = 0;
+    for (; close < text.size(); ++close) {
+      char c = text[close];
+      if (quote) {
+        quote = c == quote ? 0 : quote;
+      } else if (c == '"' || c == '\'') {
+        quote = c;
+      } else if (c == '>') {
+        break;
+      }
+    }
+    if (close == text.size()) {
+      return true;
+    }
+    size_t tag = position;
+    position = close + 1;
+
+    char kind = text[tag + 1];
+    if (kind == '?' || kind == '!') {
+      continue;
+    }
+    if (kind == '/') {
+      if (open.empty()) {
+        continue;
+      }
+      open.pop_back();
+      if (entry == std::string::npos) {
+        continue;
+      }
+      if (open.size() == entry + 1 && capture != none) {
+        // the end of the id, guid or link
+        Capture ended = capture;
+        capture = none;
+        if (ended == link) {
+          entryLink.swap(captured);
+        } else {
+          identified = true;
+          if (!report(captured, found)) {
+            return false;
+          }
+        }
+      } else if (open.size() == entry) {
+        if (!identified && !report(entryLink, found)) {
+          return false;
+        }
+        entry = std::string::npos;
+        ++count;
+      }
+      continue;
+    }
+
+    size_t nameEnd = tag + 1;
+    while (nameEnd < close && !is_space(text[nameEnd]) && text[nameEnd] != '/') {
+      ++nameEnd;
+    }
+    std::string name = text.substr(tag + 1, nameEnd - tag - 1);
+    bool empty = text[close - 1] == '/';
+    if (entry == std::string::npos) {
+      if (!empty && (name == "entry" || name == "item")) {
+        entry = open.size();
+        entryStart = tag;
+        atom = name == "entry";
+        identified = false;
+        entryLink.clear();
+      }
+    } else if (!empty && open.size() == entry + 1 && capture == none) {
+      if (!identified && name == (atom ? "id" : "guid")) {
+        capture = id;
+        captured.clear();
+      } else if (!atom && name == "link") {
+        capture = link;
+        captured.clear();
+      }
+    }
+    if (!empty) {
+      open.push_back(std::move(name));
+    }
+  }
+  return true;
+}
+
+std::string EntryScanner::truncated(const std::string& text) const
+{
+  std::string document = text.substr(0, stop);
+  for (auto name = openAtStop.rbegin(); name != openAtStop.rend(); ++name) {
+    document += "</" + *name + ">";
+  }
+  return document;
+}
+
+SeenEntries::SeenEntries(size_t m, size_t f)
+  : max_per_feed(m)
+  , full_every(f)
+{
+}
+
+void SeenEntries::delivered(const std::string& feed, const std::string& id)
+{
+  if (id.empty()) {
+    return;
+  }
+  std::unique_lock<std::mutex> guard(lock);
+  Feed& seen = feeds[feed];
+  if (!seen.ids.insert(id).second) {
+    return;
+  }
+  seen.order.push_back(id);
+  if (seen.order.size() > max_per_feed) {
+    seen.ids.erase(seen.order.front());
+    seen.order.pop_front();
+  }
+}
+
+bool SeenEntries::seen(const std::string& feed, const std::string& id) const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto found = feeds.find(feed);
+  return found != feeds.end() && found->second.ids.count(id) != 0;
+}
+
+bool SeenEntries::ordered(const std::string& feed) const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto found = feeds.find(feed);
+  return found != feeds.end() && found->second.stops != 0;
+}
+
+void SeenEntries::checked(const std::string& feed, bool newest_first)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto found = feeds.find(feed);
+  if (found == feeds.end()) {
+    return;
+  }
+  found->second.stops = newest_first ? full_every : 0;
+  ++counters.checked;
+  if (!newest_first) {
+    ++counters.unordered;
+  }
+}
+
+void SeenEntries::stopped(const std::string& feed, bool first, size_t received, size_t advertised)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto found = feeds.find(feed);
+  if (found != feeds.end() && found->second.stops != 0) {
+    --found->second.stops;
+  }
+  ++counters.stopped;
+  if (first) {
+    ++counters.unchanged;
+  }
+  counters.received += received;
+  counters.advertised += advertised;
+}
+
+void SeenEntries::forget(const std::string& feed)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  feeds.erase(feed);
+}
+
+SeenEntries::Stats SeenEntries::stats() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return counters;
+}
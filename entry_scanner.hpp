@@ -0,0 +1,150 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#pragma once
+#ifndef ___ENTRY_SCANNER_INC__
+#define ___ENTRY_SCANNER_INC__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <mutex>
+
+// recognizes the entries of an atom or rss feed as its bytes arrive,
+// without building a document. the id of an atom <entry> is its <id>,
+// that of an rss <item> its <guid>, or its <link> when it has no guid,
+// decoded as rapidxml would decode them.
+class EntryScanner
+{
+public:
+  // called with each entry id, returns false to stop at that entry
+  typedef std::function<bool(const std::string& id)> Found;
+
+  EntryScanner();
+
+  // scans the bytes of text added since the last call. text is the
+  // document so far, it only ever grows. returns false once found has
+  // stopped the scan, later calls do nothing.
+  bool scan(const std::string& text, const Found& found);
+
+  bool stopped() const { return stop != std::string::npos; }
+
+  // once stopped, the offset in text of the entry the scan stopped at
+  size_t stopped_at() const { return stop; }
+
+  // the entries before the one the scan stopped at
+  size_t entries() const { return count; }
+
+  // once stopped, text up to the entry the scan stopped at with the
+  // elements open there closed, a document holding only the entries
+  // before it
+  std::string truncated(const std::string& text) const;
+
+private:
+  enum Capture { none, id, link };
+
+  // reports an id, returns false when found stops the scan
+  bool report(const std::string& value, const Found& found);
+
+  size_t position;
+  std::vector<std::string> open;
+  // the depth of the entry being scanned in open, or npos
+  size_t entry;
+  size_t entryStart;
+  bool atom;
+  bool identified;
+  Capture capture;
+  std::string captured;
+  std::string entryLink;
+  size_t count;
+  size_t stop;
+  std::vector<std::string> openAtStop;
+};
+
+// the entry ids delivered for each feed, the most recent max_per_feed
+// of them. a fetch may only stop at a seen entry once a whole fetch of
+// the feed showed that it lists its new entries first, and every
+// full_every fetches that stopped the feed is fetched whole again to
+// check that it still does.
+class SeenEntries
+{
+public:
+  struct Stats
+  {
+    Stats() : stopped(0), unchanged(0), received(0), advertised(0), checked(0), unordered(0) {}
+    // fetches ended at an entry that was seen before
+    size_t stopped;
+    // of them, those that stopped at the first entry
+    size_t unchanged;
+    // body bytes the stopped fetches received, and those that their
+    // Content-Length promised when they had one
+    size_t received;
+    size_t advertised;
+    // whole fetches scanned past a seen entry, and those that found a
+    // new entry after it
+    size_t checked;
+    size_t unordered;
+  };
+
+  explicit SeenEntries(size_t max_per_feed = 512, size_t full_every = 16);
+
+  void delivered(const std::string& feed, const std::string& id);
+  bool seen(const std::string& feed, const std::string& id) const;
+
+  // true when a fetch of feed may stop at the first seen entry
+  bool ordered(const std::string& feed) const;
+
+  // a whole fetch of feed was scanned past an entry seen before.
+  // newest_first is false when a new entry came after it.
+  void checked(const std::string& feed, bool newest_first);
+
+  // a fetch of a feed was stopped at a seen entry. advertised is zero
+  // when the length was not known.
+  void stopped(const std::string& feed, bool first, size_t received, size_t advertised);
+
+  // drops what is known of a feed that is no longer polled
+  void forget(const std::string& feed);
+
+  Stats stats() const;
+
+private:
+  struct Feed
+  {
+    Feed() : stops(0) {}
+    std::unordered_set<std::string> ids;
+    std::deque<std::string> order;
+    // the fetches that may still stop before the next whole one
+    size_t stops;
+  };
+
+  size_t max_per_feed;
+  size_t full_every;
+  mutable std::mutex lock;
+  std::unordered_map<std::string, Feed> feeds;
+  Stats counters;
+};
+
+#endif  // ___ENTRY_SCANNER_INC__
@@ -0,0 +1,100 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "feed_body.hpp"
+
+FeedBody::FeedBody(std::string&& t)
+  : text(std::move(t))
+  , held(0)
+{
+  ++body_counters().bodies;
+  body_counters().bytes += text.size();
+}
+
+FeedBody::FeedBody(std::unique_ptr<LocalDocument> l)
+  : local(std::move(l))
+  , held(0)
+{
+  ++body_counters().bodies;
+  body_counters().bytes += local->size();
+}
+
+FeedBody::~FeedBody()
+{
+  if (budget) {
+    budget->release(MemoryBudget::parsed, held);
+  }
+}
+
+char* FeedBody::data()
+{
+  return local ? local->data() : &text[0];
+}
+
+size_t FeedBody::size() const
+{
+  return local ? local->size() : text.size();
+}
+
+bool FeedBody::truncated() const
+{
+  return local && local->truncated();
+}
+
+void FeedBody::adopt(DocumentPool::Document d)
+{
+  doc = std::move(d);
+}
+
+void FeedBody::charge(std::shared_ptr<MemoryBudget> b, size_t bytes)
+{
+  b->charge(MemoryBudget::parsed, bytes);
+  budget = std::move(b);
+  held += bytes;
+}
+
+void FeedBody::when_parsed(std::function<void()> d)
+{
+  done = std::move(d);
+}
+
+void FeedBody::parsed()
+{
+  if (done) {
+    auto once = std::move(done);
+    done = nullptr;
+    once();
+  }
+}
+
+BodyCounters& body_counters()
+{
+  static BodyCounters counters;
+  return counters;
+}
+
+void count_body_copy(size_t size)
+{
+  ++body_counters().copies;
+  body_counters().copied_bytes += size;
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___FEED_BODY_INC__
+#define ___FEED_BODY_INC__
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include "rapidxml/rapidxml.hpp"
+#include "document_pool.hpp"
+#include "local_source.hpp"
+#include "memory_budget.hpp"
+
+// the body of one fetched document, moved along the pipeline and never
+// copied. XmlParse parses it in place into a document from its pool,
+// the document then points into the text and the two are released
+// together.
+class FeedBody
+{
+public:
+  // takes text without copying it
+  explicit FeedBody(std::string&& text);
+  // the document of a local uri, mapped rather than read
+  explicit FeedBody(std::unique_ptr<LocalDocument> local);
+  ~FeedBody();
+
+  // the text, writable and followed by a 0 so that it can be parsed in situ
+  char* data();
+  size_t size() const;
+
+  // true when the text is a local file that shrank while it was mapped
+  bool truncated() const;
+
+  // takes doc, the document to parse the text into
+  void adopt(DocumentPool::Document doc);
+  rapidxml::xml_document<>& document() { return *doc; }
+
+  // charges bytes to the parsed stage of budget until this is destroyed
+  void charge(std::shared_ptr<MemoryBudget> budget, size_t bytes);
+
+  // done is called by parsed(), once the text has been parsed. the
+  // fetch stage uses it to keep the validators of the response.
+  void when_parsed(std::function<void()> done);
+  void parsed();
+
+private:
+  FeedBody(const FeedBody&);
+  FeedBody& operator=(const FeedBody&);
+
+  std::string text;
+  std::unique_ptr<LocalDocument> local;
+  // after the text, so it is returned to its pool first
+  DocumentPool::Document doc;
+  std::shared_ptr<MemoryBudget> budget;
+  size_t held;
+  std::function<void()> done;
+};
+
+// the bodies taken into the pipeline, and the copies made of bodies on
+// the way there
+struct BodyCounters
+{
+  BodyCounters() : bodies(0), bytes(0), copies(0), copied_bytes(0) {}
+  std::atomic<size_t> bodies;
+  std::atomic<size_t> bytes;
+  std::atomic<size_t> copies;
+  std::atomic<size_t> copied_bytes;
+};
+
+BodyCounters& body_counters();
+
+// counts a copy of a body of size bytes
+void count_body_copy(size_t size);
+
+#endif  // ___FEED_BODY_INC__
@@ -0,0 +1,61 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___FEED_ERROR_INC__
+#define ___FEED_ERROR_INC__
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <exception>
+
+// a failure of one feed in one stage of the pipeline
+struct FeedError
+{
+  std::string uri;
+  // the News:: chain tag of the stage, e.g. "xml_parse"
+  std::string stage;
+  std::string reason;
+  // from the time the stage started on the feed until it failed
+  std::chrono::steady_clock::duration duration;
+};
+
+// the message of the exception in error
+std::string describe(const std::exception_ptr& error);
+
+// failures per stage
+class FailureCounters
+{
+public:
+  typedef std::map<std::string, size_t> Stages;
+
+  void record(const std::string& stage);
+  Stages stages() const;
+
+private:
+  mutable std::mutex lock;
+  Stages failures;
+};
+
+#endif  // ___FEED_ERROR_INC__
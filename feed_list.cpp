@@ -0,0 +1,189 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "feed_list.hpp"
+#include "rapidxml/rapidxml.hpp"
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// interns the xmlUrl of every outline under node
+void read_outlines(rapidxml::xml_node<>* node, UriTable& feeds)
+{
+  // outlines nest as deep as the folders of the list, walked without recursion
+  std::vector<rapidxml::xml_node<>*> pending(1, node);
+  while (!pending.empty()) {
+    rapidxml::xml_node<>* parent = pending.back();
+    pending.pop_back();
+    for (auto child = parent->first_node(); child; child = child->next_sibling()) {
+      if (child->type() != rapidxml::node_element) {
+        continue;
+      }
+      if (rapidxml::internal::compare(child->name(), child->name_size(), "outline", 7, false)) {
+        auto url = child->first_attribute("xmlUrl", 6, false);
+        if (url && url->value_size() != 0) {
+          feeds.intern(url->value(), url->value_size());
+        }
+      }
+      if (child->first_node()) {
+        pending.push_back(child);
+      }
+    }
+  }
+}
+
+// reads the file at path into text, followed by a 0. the list is read
+// rather than mapped, a mapping would fault when the file is truncated
+// while it is read, as an editor or a script rewriting it may do.
+void read_file(const std::string& path, std::vector<char>& text)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+  }
+  struct stat status;
+  size_t size = 0;
+  text.resize(::fstat(fd, &status) == 0 && status.st_size > 0 ? status.st_size + 1 : 4096);
+  for (;;) {
+    if (size == text.size()) {
+      // the file grew since it was examined
+      text.resize(text.size() * 2);
+    }
+    ssize_t got = ::read(fd, text.data() + size, text.size() - size);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got < 0) {
+      int error = errno;
+      ::close(fd);
+      throw std::runtime_error("cannot read " + path + ": " + std::strerror(error));
+    }
+    if (got == 0) {
+      break;
+    }
+    size += got;
+  }
+  ::close(fd);
+  text.resize(size + 1);
+  text[size] = 0;
+}
+
+void read_lines(const char* text, size_t size, UriTable& feeds)
+{
+  const char* end = text + size;
+  for (const char* line = text; line < end;) {
+    const char* next = static_cast<const char*>(std::memchr(line, '\n', end - line));
+    if (!next) {
+      next = end;
+    }
+    const char* first = line;
+    const char* last = next;
+    while (first < last && is_space(*first)) {
+      ++first;
+    }
+    while (last > first && is_space(last[-1])) {
+      --last;
+    }
+    if (first < last && *first != '#') {
+      feeds.intern(first, last - first);
+    }
+    line = next + 1;
+  }
+}
+
+}
+
+void read_feed_list(const std::string& path, UriTable& feeds)
+{
+  std::vector<char> list;
+  read_file(path, list);
+  char* text = list.data();
+  size_t size = list.size() - 1;
+  size_t start = 0;
+  // a utf-8 byte order mark
+  if (size >= 3 && std::memcmp(text, "\xEF\xBB\xBF", 3) == 0) {
+    start = 3;
+  }
+  while (start < size && is_space(text[start])) {
+    ++start;
+  }
+  if (start == size || text[start] != '<') {
+    read_lines(text + start, size - start, feeds);
+    return;
+  }
+  rapidxml::xml_document<> doc;
+  try {
+    doc.parse<rapidxml::parse_no_data_nodes>(text + start);
+  } catch (const rapidxml::parse_error& e) {
+    throw std::runtime_error(path + ": " + e.what());
+  }
+  read_outlines(&doc, feeds);
+}
+
+FeedListFile::FeedListFile(std::string path)
+  : file(std::move(path))
+{
+}
+
+FeedListFile::Version FeedListFile::version() const
+{
+  Version result;
+  struct stat status;
+  if (::stat(file.c_str(), &status) != 0) {
+    throw std::runtime_error("cannot stat " + file + ": " + std::strerror(errno));
+  }
+  result.size = status.st_size;
+  result.modified = static_cast<long long>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+  return result;
+}
+
+bool FeedListFile::changed() const
+{
+  Version now = version();
+  return now.size != last.size || now.modified != last.modified;
+}
+
+bool FeedListFile::read(UriTable& feeds)
+{
+  Version before = version();
+  feeds.clear();
+  read_feed_list(file, feeds);
+  Version after = version();
+  if (after.size != before.size || after.modified != before.modified) {
+    return false;
+  }
+  last = after;
+  return true;
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___FEED_LIST_INC__
+#define ___FEED_LIST_INC__
+
+#include <string>
+#include "uri_table.hpp"
+
+// interns the feeds listed in the file at path into feeds. the file is
+// an OPML document, whose outlines with an xmlUrl are the feeds, or a
+// uri per line with blank lines and lines starting with # passed over.
+// the file is read into memory and parsed in place. throws when it cannot be read
+// or parsed.
+void read_feed_list(const std::string& path, UriTable& feeds);
+
+// a feed list that is read again when the file changes
+class FeedListFile
+{
+public:
+  explicit FeedListFile(std::string path);
+
+  const std::string& path() const { return file; }
+
+  // true when the size or modification time of the file differ from
+  // when it was last read, or it has not been read
+  bool changed() const;
+
+  // reads the list into feeds, which is cleared first. returns false
+  // when the file changed while it was read, it may have been read
+  // half written and is read again on the next change.
+  bool read(UriTable& feeds);
+
+private:
+  struct Version
+  {
+    Version() : size(-1), modified(-1) {}
+    long long size;
+    long long modified;
+  };
+  Version version() const;
+
+  std::string file;
+  Version last;
+};
+
+#endif  // ___FEED_LIST_INC__
@@ -0,0 +1,455 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "feed_stream.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+namespace {
+
+void append_utf8(std::string& out, unsigned long code)
+{
+  if (code < 0x80) {
+    out += static_cast<char>(code);
+  } else if (code < 0x800) {
+    out += static_cast<char>(0xc0 | (code >> 6));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  } else if (code < 0x10000) {
+    out += static_cast<char>(0xe0 | (code >> 12));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  } else {
+    out += static_cast<char>(0xf0 | (code >> 18));
+    out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  }
+}
+
+bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+const char* find(const char* begin, const char* end, const char* text)
+{
+  size_t size = std::strlen(text);
+  for (const char* at = begin; end - at >= static_cast<ptrdiff_t>(size); ++at) {
+    at = static_cast<const char*>(std::memchr(at, text[0], end - at));
+    if (!at || end - at < static_cast<ptrdiff_t>(size)) {
+      return nullptr;
+    }
+    if (std::memcmp(at, text, size) == 0) {
+      return at;
+    }
+  }
+  return nullptr;
+}
+
+// a reference longer than this is not one, the '&' is taken as it is
+const size_t max_reference = 32;
+
+}  // namespace
+
+void append_xml_text(std::string& out, const char* begin, const char* end)
+{
+  static const struct { const char* name; char value; } entities[] = {
+    {"&lt;", '<'}, {"&gt;", '>'}, {"&amp;", '&'}, {"&quot;", '"'}, {"&apos;", '\''}
+  };
+  while (begin < end) {
+    const char* amp = static_cast<const char*>(std::memchr(begin, '&', end - begin));
+    if (!amp) {
+      out.append(begin, end);
+      return;
+    }
+    out.append(begin, amp);
+    begin = amp + 1;
+    const char* semicolon = static_cast<const char*>(std::memchr(amp, ';', end - amp));
+    if (semicolon && amp + 2 < semicolon && amp[1] == '#') {
+      bool hex = amp[2] == 'x';
+      char* parsed = nullptr;
+      unsigned long code = std::strtoul(amp + (hex ? 3 : 2), &parsed, hex ? 16 : 10);
+      if (parsed == semicolon) {
+        append_utf8(out, code);
+        begin = semicolon + 1;
+        continue;
+      }
+    }
+    bool replaced = false;
+    for (auto& entity : entities) {
+      size_t size = std::strlen(entity.name);
+      if (static_cast<size_t>(end - amp) >= size && std::memcmp(amp, entity.name, size) == 0) {
+        out += entity.value;
+        begin = amp + size;
+        replaced = true;
+        break;
+      }
+    }
+    if (!replaced) {
+      out += '&';
+    }
+  }
+}
+
+XmlTokenizer::XmlTokenizer(Handler& h)
+  : handler(h)
+  , state(markup)
+  , root(false)
+  , position(0)
+  , peak(0)
+{
+}
+
+void XmlTokenizer::write(const char* data, size_t size)
+{
+  if (position == pending.size()) {
+    // nothing held, read the piece where it is
+    pending.clear();
+    position = 0;
+    size_t read = this->read(data, size);
+    pending.append(data + read, size - read);
+  } else {
+    pending.append(data, size);
+    position += read(pending.data() + position, pending.size() - position);
+    if (position > pending.size() / 2) {
+      pending.erase(0, position);
+      position = 0;
+    }
+  }
+  if (buffered() > peak) {
+    peak = buffered();
+  }
+}
+
+void XmlTokenizer::finish()
+{
+  const char* rest = pending.data() + position;
+  const char* end = pending.data() + pending.size();
+  while (rest < end && is_space(*rest)) {
+    ++rest;
+  }
+  if (!root || !open.empty() || state != markup || rest != end) {
+    throw std::runtime_error("xml: unexpected end of document");
+  }
+}
+
+void XmlTokenizer::emit(const char* begin, const char* end)
+{
+  if (begin == end || open.empty()) {
+    return;
+  }
+  if (!std::memchr(begin, '&', end - begin)) {
+    handler.text(begin, end - begin);
+    return;
+  }
+  decoded.clear();
+  append_xml_text(decoded, begin, end);
+  handler.text(decoded.data(), decoded.size());
+}
+
+size_t XmlTokenizer::read(const char* data, size_t size)
+{
+  const char* at = data;
+  const char* end = data + size;
+  while (at < end) {
+    if (state == cdata || state == comment) {
+      const char* close = find(at, end, state == cdata ? "]]>" : "-->");
+      // the last two bytes might begin the close
+      const char* stop = close ? close : std::max(at, end - 2);
+      if (state == cdata && !open.empty() && stop != at) {
+        handler.text(at, stop - at);
+      }
+      if (!close) {
+        return stop - data;
+      }
+      at = close + 3;
+      state = markup;
+      continue;
+    }
+
+    const char* lt = static_cast<const char*>(std::memchr(at, '<', end - at));
+    if (!lt) {
+      // hold back a reference that may be cut off
+      const char* stop = end;
+      for (const char* amp = end; amp > at && end - amp < static_cast<ptrdiff_t>(max_reference); ) {
+        --amp;
+        if (*amp == ';') {
+          break;
+        }
+        if (*amp == '&') {
+          stop = amp;
+          break;
+        }
+      }
+      emit(at, stop);
+      return stop - data;
+    }
+    emit(at, lt);
+    at = lt;
+
+    if (end - at < 2) {
+      break;
+    }
+    if (at[1] == '!') {
+      if (end - at < 4) {
+        break;
+      }
+      if (std::memcmp(at, "<!--", 4) == 0) {
+        at += 4;
+        state = comment;
+        continue;
+      }
+      if (end - at < 9) {
+        break;
+      }
+      if (std::memcmp(at, "<![CDATA[", 9) == 0) {
+        at += 9;
+        state = cdata;
+        continue;
+      }
+      // a doctype, past the '>' of any internal subset
+      const char* close = at + 2;
+      int brackets = 0;
+      for (; close < end; ++close) {
+        if (*close == '[') {
+          ++brackets;
+        } else if (*close == ']') {
+          --brackets;
+        } else if (*close == '>' && brackets <= 0) {
+          break;
+        }
+      }
+      if (close == end) {
+        break;
+      }
+      at = close + 1;
+      continue;
+    }
+    if (at[1] == '?') {
+      const char* close = find(at + 2, end, "?>");
+      if (!close) {
+        break;
+      }
+      at = close + 2;
+      continue;
+    }
+
+    // the end of the tag, past any '>' in quoted attribute values
+    const char* close = at + 1;
+    char quote = 0;
+    for (; close < end; ++close) {
+      char c = *close;
+      if (quote) {
+        quote = c == quote ? 0 : quote;
+      } else if (c == '"' || c == '\'') {
+        quote = c;
+      } else if (c == '>') {
+        break;
+      }
+    }
+    if (close == end) {
+      break;
+    }
+    const char* tag = at;
+    at = close + 1;
+
+    bool closing = tag[1] == '/';
+    const char* name = tag + (closing ? 2 : 1);
+    const char* nameEnd = name;
+    while (nameEnd < close && !is_space(*nameEnd) && *nameEnd != '/') {
+      ++nameEnd;
+    }
+    if (name == nameEnd) {
+      throw std::runtime_error("xml: expected element name");
+    }
+    std::string element(name, nameEnd);
+    if (closing) {
+      if (open.empty() || open.back() != element) {
+        throw std::runtime_error("xml: invalid closing tag </" + element + ">");
+      }
+      open.pop_back();
+      handler.end(element);
+      continue;
+    }
+    if (open.empty()) {
+      if (root) {
+        throw std::runtime_error("xml: more than one root element");
+      }
+      root = true;
+    }
+    bool empty = close[-1] == '/';
+    open.push_back(element);
+    handler.start(element);
+    if (empty) {
+      open.pop_back();
+      handler.end(element);
+    }
+  }
+  return at - data;
+}
+
+FeedStream::FeedStream(Emit e)
+  : emit(std::move(e))
+  , tokenizer(*this)
+  , format(unknown)
+  , depth(0)
+  , channel(false)
+  , author(false)
+  , inEntry(false)
+  , captured(nullptr)
+  , capturedDepth(0)
+  , count(0)
+{
+}
+
+void FeedStream::write(const char* data, size_t size)
+{
+  tokenizer.write(data, size);
+}
+
+void FeedStream::finish()
+{
+  tokenizer.finish();
+}
+
+void FeedStream::capture(std::string& field)
+{
+  if (field.empty()) {
+    captured = &field;
+    capturedDepth = depth;
+  }
+}
+
+void FeedStream::start(const std::string& name)
+{
+  // the depth of the element, the root is 1
+  ++depth;
+  if (captured) {
+    return;
+  }
+  if (depth == 1) {
+    if (name == "feed") {
+      format = atom_feed;
+    } else if (name == "rss") {
+      format = rss_channel;
+    } else {
+      throw std::runtime_error("not an atom or rss document: " + name);
+    }
+    return;
+  }
+  if (format == atom_feed) {
+    if (inEntry && depth == 3) {
+      if (name == "id") {
+        capture(entry.id);
+      } else if (name == "title") {
+        capture(entry.title);
+      } else if (name == "published") {
+        capture(entry.published);
+      } else if (name == "updated") {
+        capture(entry.updated);
+      } else if (name == "summary") {
+        capture(entry.summary);
+      } else if (name == "content") {
+        capture(entry.content);
+      }
+    } else if (author && depth == 3) {
+      if (name == "name") {
+        capture(feed.author_name);
+      } else if (name == "email") {
+        capture(feed.author_email);
+      }
+    } else if (depth == 2) {
+      if (name == "entry") {
+        inEntry = true;
+      } else if (name == "author") {
+        author = true;
+      } else if (name == "id") {
+        capture(feed.id);
+      } else if (name == "title") {
+        capture(feed.title);
+      } else if (name == "subtitle") {
+        capture(feed.subtitle);
+      } else if (name == "updated") {
+        capture(feed.updated);
+      }
+    }
+    return;
+  }
+  if (depth == 2) {
+    channel = name == "channel";
+  } else if (channel && inEntry && depth == 4) {
+    if (name == "title") {
+      capture(entry.title);
+    } else if (name == "link") {
+      capture(entry.link);
+    } else if (name == "guid") {
+      capture(entry.id);
+    } else if (name == "author") {
+      capture(entry.author);
+    } else if (name == "description") {
+      capture(entry.content);
+    }
+  } else if (channel && depth == 3) {
+    if (name == "item") {
+      inEntry = true;
+    } else if (name == "title") {
+      capture(feed.title);
+    } else if (name == "link") {
+      capture(feed.link);
+    } else if (name == "ttl") {
+      capture(feed.ttl);
+    } else if (name == "sy:updatePeriod") {
+      capture(feed.update_period);
+    } else if (name == "sy:updateFrequency") {
+      capture(feed.update_frequency);
+    }
+  }
+}
+
+void FeedStream::end(const std::string&)
+{
+  if (captured && depth == capturedDepth) {
+    captured = nullptr;
+  }
+  size_t entryDepth = format == atom_feed ? 2 : 3;
+  if (inEntry && depth == entryDepth) {
+    inEntry = false;
+    ++count;
+    emit(*this, entry);
+    entry = Entry();
+  } else if (author && depth == 2) {
+    author = false;
+  } else if (channel && depth == 2) {
+    channel = false;
+  }
+  --depth;
+}
+
+void FeedStream::text(const char* data, size_t size)
+{
+  if (captured && depth == capturedDepth) {
+    captured->append(data, size);
+  }
+}
@@ -0,0 +1,157 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___FEED_STREAM_INC__
+#define ___FEED_STREAM_INC__
+
+#include <string>
+#include <vector>
+#include <functional>
+
+// appends the character data in [begin, end) with the character
+// references and the predefined entities replaced, as rapidxml does
+void append_xml_text(std::string& out, const char* begin, const char* end);
+
+// reads xml as it arrives, in pieces of any size, and reports the
+// elements and the text within them as they are read. only the piece
+// of markup or the reference cut off at the end of a write is held
+// until the next, so the memory used does not grow with the document.
+// attributes, processing instructions, comments and the doctype are
+// skipped.
+class XmlTokenizer
+{
+public:
+  struct Handler
+  {
+    virtual ~Handler() {}
+    // the name as written, prefix and all, e.g. "sy:updatePeriod"
+    virtual void start(const std::string& name) = 0;
+    virtual void end(const std::string& name) = 0;
+    // character data, decoded, or a CDATA section directly within the
+    // innermost open element. one run of text may arrive in pieces.
+    virtual void text(const char* data, size_t size) = 0;
+  };
+
+  explicit XmlTokenizer(Handler& handler);
+
+  // throws std::runtime_error for markup that is not well formed
+  void write(const char* data, size_t size);
+
+  // the end of the document, throws if it is not complete
+  void finish();
+
+  // the bytes held from one write to the next, now and at most
+  size_t buffered() const { return pending.size() - position; }
+  size_t peak_buffered() const { return peak; }
+
+private:
+  enum State { markup, cdata, comment };
+
+  // reads what it can of [data, data + size), returns the bytes read
+  size_t read(const char* data, size_t size);
+  void emit(const char* begin, const char* end);
+
+  Handler& handler;
+  State state;
+  std::vector<std::string> open;
+  bool root;
+  std::string pending;
+  size_t position;
+  size_t peak;
+  std::string decoded;
+};
+
+// extracts the entries of an atom feed or rss channel from its text as
+// it arrives, without building a document. emit is called as each
+// <entry> or <item> closes. the fields of the feed are the ones read by
+// then, which in practice come ahead of the entries. the text of a
+// field is all the text directly within it.
+class FeedStream : private XmlTokenizer::Handler
+{
+public:
+  struct Source
+  {
+    std::string id;
+    std::string title;
+    std::string subtitle;
+    std::string link;
+    std::string updated;
+    std::string author_name;
+    std::string author_email;
+    std::string ttl;
+    std::string update_period;
+    std::string update_frequency;
+  };
+
+  struct Entry
+  {
+    std::string id;
+    std::string title;
+    std::string author;
+    std::string link;
+    std::string published;
+    std::string updated;
+    std::string summary;
+    std::string content;
+  };
+
+  typedef std::function<void(const FeedStream& feed, const Entry& entry)> Emit;
+
+  explicit FeedStream(Emit emit);
+
+  // throws std::runtime_error for a document that is not well formed
+  // or is not an atom feed or rss document
+  void write(const char* data, size_t size);
+  void finish();
+
+  bool atom() const { return format == atom_feed; }
+  const Source& source() const { return feed; }
+  size_t entries() const { return count; }
+  size_t peak_buffered() const { return tokenizer.peak_buffered(); }
+
+private:
+  enum Format { unknown, atom_feed, rss_channel };
+
+  void start(const std::string& name);
+  void end(const std::string& name);
+  void text(const char* data, size_t size);
+
+  // captures the text of the element just started into field, unless
+  // the field was read from an earlier one
+  void capture(std::string& field);
+
+  Emit emit;
+  XmlTokenizer tokenizer;
+  Format format;
+  size_t depth;
+  bool channel;
+  bool author;
+  bool inEntry;
+  std::string* captured;
+  size_t capturedDepth;
+  Source feed;
+  Entry entry;
+  size_t count;
+};
+
+#endif  // ___FEED_STREAM_INC__
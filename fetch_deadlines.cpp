@@ -0,0 +1,58 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "fetch_deadlines.hpp"
+#include <algorithm>
+#include <cmath>
+
+const size_t LatencyHistory::capacity;
+
+void LatencyHistory::record(const std::string& uri, duration latency)
+{
+  auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(latency).count();
+  std::unique_lock<std::mutex> guard(lock);
+  Samples& samples = feeds[uri];
+  samples.milliseconds[samples.next] = static_cast<std::uint32_t>(std::max<long long>(0, milliseconds));
+  samples.next = static_cast<std::uint8_t>((samples.next + 1) % capacity);
+  if (samples.size < capacity) {
+    ++samples.size;
+  }
+}
+
+LatencyHistory::duration LatencyHistory::percentile(const std::string& uri, double p, size_t min_samples) const
+{
+  std::uint32_t sorted[capacity];
+  size_t size;
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    auto found = feeds.find(uri);
+    if (found == feeds.end() || found->second.size < std::max<size_t>(1, min_samples)) {
+      return duration::zero();
+    }
+    size = found->second.size;
+    std::copy(found->second.milliseconds, found->second.milliseconds + size, sorted);
+  }
+  std::sort(sorted, sorted + size);
+  size_t rank = static_cast<size_t>(std::ceil(p * size));
+  rank = std::min(size, std::max<size_t>(1, rank)) - 1;
+  return std::chrono::milliseconds(sorted[rank]);
+}
@@ -0,0 +1,217 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___FETCH_DEADLINES_INC__
+#define ___FETCH_DEADLINES_INC__
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <cstdint>
+
+struct FetchDeadlines
+{
+  FetchDeadlines()
+    : first_byte(std::chrono::seconds(10))
+    , total(std::chrono::seconds(30))
+    , max_retries(2)
+    , retry_backoff(std::chrono::milliseconds(500))
+    , hedge(false)
+    , hedge_min_samples(5)
+  {}
+  // from the start of an attempt until the response headers arrive,
+  // including name resolution and connecting
+  std::chrono::steady_clock::duration first_byte;
+  // from the start of an attempt until the body is complete
+  std::chrono::steady_clock::duration total;
+  // attempts after the first for timeouts, network errors and 429/5xx
+  size_t max_retries;
+  // delay before the first retry, doubled for each one after
+  std::chrono::steady_clock::duration retry_backoff;
+  // start a second attempt when the first passes the feed's p95 latency
+  bool hedge;
+  // latencies a feed needs before it is hedged
+  size_t hedge_min_samples;
+};
+
+struct DeadlineCounters
+{
+  DeadlineCounters() : timeouts(0), retries(0), hedges(0), hedge_wins(0) {}
+  std::atomic<size_t> timeouts;
+  std::atomic<size_t> retries;
+  // second attempts started because the first was slower than p95
+  std::atomic<size_t> hedges;
+  // hedges that finished before the attempt they hedged
+  std::atomic<size_t> hedge_wins;
+};
+
+// an attempt passed its first byte or total deadline
+class fetch_timeout : public std::runtime_error
+{
+public:
+  explicit fetch_timeout(const std::string& what) : std::runtime_error(what) {}
+};
+
+// the last few fetch latencies of each feed
+class LatencyHistory
+{
+public:
+  typedef std::chrono::steady_clock::duration duration;
+
+  void record(const std::string& uri, duration latency);
+
+  // the p percentile of the recorded latencies, zero when fewer than
+  // min_samples have been recorded
+  duration percentile(const std::string& uri, double p, size_t min_samples) const;
+
+private:
+  static const size_t capacity = 20;
+  struct Samples
+  {
+    Samples() : next(0), size(0) {}
+    std::uint32_t milliseconds[capacity];
+    std::uint8_t next;
+    std::uint8_t size;
+  };
+
+  mutable std::mutex lock;
+  std::unordered_map<std::string, Samples> feeds;
+};
+
+// runs attempts at producing a T on their own threads and waits for the
+// first to succeed. attempts that lose or time out are abandoned, they
+// finish in the background and their result is dropped.
+template<class T>
+class Race : public std::enable_shared_from_this<Race<T>>
+{
+public:
+  // passed to each attempt to report progress and check abandonment
+  class Entrant
+  {
+  public:
+    void first_byte()
+    {
+      std::unique_lock<std::mutex> guard(race->lock);
+      race->started = true;
+      race->wake.notify_all();
+    }
+    bool abandoned() const { return race->abandoned; }
+    size_t index() const { return position; }
+
+  private:
+    friend class Race;
+    Entrant(std::shared_ptr<Race> r, size_t p) : race(std::move(r)), position(p) {}
+    std::shared_ptr<Race> race;
+    size_t position;
+  };
+
+  typedef std::function<T(Entrant&)> Run;
+
+  enum Outcome { pending, won, failed };
+
+  Race() : started(false), abandoned(false), running(0), launched(0), winner(-1) {}
+
+  // starts another attempt
+  void launch(Run run)
+  {
+    std::shared_ptr<Race> self = this->shared_from_this();
+    size_t position;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      position = launched++;
+      ++running;
+    }
+    std::thread([self, run, position]{
+      Entrant entrant(self, position);
+      T value;
+      std::exception_ptr failure;
+      try {
+        value = run(entrant);
+      } catch (...) {
+        failure = std::current_exception();
+      }
+      std::unique_lock<std::mutex> guard(self->lock);
+      --self->running;
+      if (self->winner < 0 && !self->abandoned) {
+        if (!failure) {
+          self->winner = static_cast<int>(position);
+          self->value = std::move(value);
+        } else {
+          self->error = failure;
+        }
+      }
+      self->wake.notify_all();
+    }).detach();
+  }
+
+  // waits until an attempt succeeds, every attempt has failed or deadline
+  Outcome wait_until(std::chrono::steady_clock::time_point deadline)
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    wake.wait_until(guard, deadline, [this]{ return winner >= 0 || running == 0; });
+    if (winner >= 0) {
+      return won;
+    }
+    return running == 0 ? failed : pending;
+  }
+
+  bool first_byte() const
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    return started;
+  }
+
+  // the attempt that won, valid after wait_until returns won
+  size_t winning_attempt() const { return static_cast<size_t>(winner); }
+  T take() { return std::move(value); }
+  std::exception_ptr failure() const { return error; }
+
+  // attempts still running are told to drop their results
+  void abandon()
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    abandoned = true;
+  }
+
+private:
+  mutable std::mutex lock;
+  std::condition_variable wake;
+  bool started;
+  std::atomic<bool> abandoned;
+  size_t running;
+  size_t launched;
+  int winner;
+  T value;
+  std::exception_ptr error;
+};
+
+#endif  // ___FETCH_DEADLINES_INC__
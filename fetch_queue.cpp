@@ -0,0 +1,472 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "fetch_queue.hpp"
+#include "token_bucket.hpp"
+#include <algorithm>
+#include <thread>
+#include <cctype>
+
+std::string host_key(const std::string& uri)
+{
+  std::string scheme;
+  std::string::size_type cursor = uri.find("://");
+  if (cursor == std::string::npos) {
+    scheme = "http";
+    cursor = 0;
+  } else {
+    scheme = uri.substr(0, cursor);
+    cursor += 3;
+  }
+  std::transform(scheme.begin(), scheme.end(), scheme.begin(), ::tolower);
+
+  std::string::size_type end = uri.find_first_of("/?#", cursor);
+  std::string authority = uri.substr(cursor, end == std::string::npos ? std::string::npos : end - cursor);
+  std::string::size_type at = authority.rfind('@');
+  if (at != std::string::npos) {
+    authority.erase(0, at + 1);
+  }
+  std::transform(authority.begin(), authority.end(), authority.begin(), ::tolower);
+
+  // a ':' after the closing ']' of an ipv6 literal (or anywhere in a name) starts the port
+  std::string::size_type bracket = authority.rfind(']');
+  std::string::size_type colon = authority.rfind(':');
+  if (colon == std::string::npos || (bracket != std::string::npos && colon < bracket)) {
+    authority += scheme == "https" ? ":443" : ":80";
+  }
+  return scheme + "://" + authority;
+}
+
+double host_rate(const FetchLimits& limits, const std::string& host)
+{
+  // host is scheme://name:port, overrides are by name
+  std::string name = host.substr(host.find("://") + 3);
+  name = name.substr(0, name.rfind(':'));
+  auto rate = limits.host_rates.find(name);
+  return rate == limits.host_rates.end() ? limits.host_rate : rate->second;
+}
+
+namespace {
+
+bool is_unreserved(char c)
+{
+  return ::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+// decodes the escapes of unreserved characters and uppercases the
+// hex digits of the rest, "%7euser%2f" becomes "~user%2F"
+std::string normalize_escapes(const std::string& text)
+{
+  std::string result;
+  result.reserve(text.size());
+  for (std::string::size_type cursor = 0; cursor < text.size(); ++cursor) {
+    if (text[cursor] == '%' && cursor + 2 < text.size() &&
+        ::isxdigit(static_cast<unsigned char>(text[cursor + 1])) &&
+        ::isxdigit(static_cast<unsigned char>(text[cursor + 2]))) {
+      char decoded = static_cast<char>(std::stoi(text.substr(cursor + 1, 2), nullptr, 16));
+      if (is_unreserved(decoded)) {
+        result += decoded;
+      } else {
+        result += '%';
+        result += static_cast<char>(::toupper(static_cast<unsigned char>(text[cursor + 1])));
+        result += static_cast<char>(::toupper(static_cast<unsigned char>(text[cursor + 2])));
+      }
+      cursor += 2;
+    } else {
+      result += text[cursor];
+    }
+  }
+  return result;
+}
+
+// removes the "." and ".." segments of path, as in RFC 3986 5.2.4
+std::string remove_dot_segments(std::string path)
+{
+  std::string result;
+  while (!path.empty()) {
+    if (path.compare(0, 3, "../") == 0) {
+      path.erase(0, 3);
+    } else if (path.compare(0, 2, "./") == 0) {
+      path.erase(0, 2);
+    } else if (path.compare(0, 3, "/./") == 0) {
+      path.erase(0, 2);
+    } else if (path == "/.") {
+      path = "/";
+    } else if (path.compare(0, 4, "/../") == 0 || path == "/..") {
+      path = path.size() == 3 ? std::string("/") : path.substr(3);
+      std::string::size_type last = result.rfind('/');
+      result.erase(last == std::string::npos ? 0 : last);
+    } else if (path == "." || path == "..") {
+      path.clear();
+    } else {
+      std::string::size_type next = path.find('/', 1);
+      result += path.substr(0, next);
+      path.erase(0, next == std::string::npos ? path.size() : next);
+    }
+  }
+  return result;
+}
+
+}
+
+std::string normalize_uri(const std::string& uri)
+{
+  std::string::size_type cursor = uri.find("://");
+  if (cursor == std::string::npos) {
+    return uri.substr(0, uri.find('#'));
+  }
+  std::string scheme = uri.substr(0, cursor);
+  std::transform(scheme.begin(), scheme.end(), scheme.begin(), ::tolower);
+  cursor += 3;
+
+  std::string::size_type end = uri.find_first_of("/?#", cursor);
+  std::string authority = uri.substr(cursor, end == std::string::npos ? std::string::npos : end - cursor);
+  std::string::size_type at = authority.rfind('@');
+  std::string::size_type host = at == std::string::npos ? 0 : at + 1;
+  std::transform(authority.begin() + host, authority.end(), authority.begin() + host, ::tolower);
+
+  std::string::size_type bracket = authority.rfind(']');
+  std::string::size_type colon = authority.rfind(':');
+  if (colon != std::string::npos && colon >= host && (bracket == std::string::npos || colon > bracket)) {
+    std::string port = authority.substr(colon + 1);
+    if (port.empty() ||
+        (scheme == "http" && port == "80") ||
+        (scheme == "https" && port == "443")) {
+      authority.erase(colon);
+    }
+  }
+
+  std::string rest = end == std::string::npos ? std::string() : uri.substr(end);
+  rest = normalize_escapes(rest.substr(0, rest.find('#')));
+  std::string::size_type query = rest.find('?');
+  std::string path = remove_dot_segments(rest.substr(0, query));
+  if (path.empty() || path[0] != '/') {
+    path.insert(0, "/");
+  }
+  return scheme + "://" + authority + path + (query == std::string::npos ? std::string() : rest.substr(query));
+}
+
+std::string feed_key(const std::string& uri)
+{
+  std::string key = normalize_uri(uri);
+  std::string::size_type cursor = key.find("://");
+  if (cursor != std::string::npos) {
+    key.erase(0, cursor + 3);
+  }
+  std::string::size_type query = key.find('?');
+  std::string::size_type path = key.find('/');
+  std::string::size_type end = query == std::string::npos ? key.size() : query;
+  if (path != std::string::npos && end > path + 1 && key[end - 1] == '/') {
+    key.erase(end - 1, 1);
+  }
+  return key;
+}
+
+struct FetchQueue::Shared
+{
+  typedef TokenBucket::clock clock;
+
+  Shared(FetchLimits l, Fetch f, Drained d)
+    : limits(l)
+    , fetch(std::move(f))
+    , drained(std::move(d))
+    , global(l.global_rate, l.global_burst, clock::now())
+    , sequence(0)
+    , pendingCount(0)
+    , inFlight(0)
+    , workers(0)
+    , closed(false)
+    , canceled(false)
+  {}
+
+  struct Pending
+  {
+    Pending() : sequence(0), retries(0), deferred(false) {}
+    // order of the push, older uris of different hosts start first
+    size_t sequence;
+    // attempts at the uri before this one
+    size_t retries;
+    bool deferred;
+    std::string uri;
+    std::string host;
+    std::string key;
+  };
+
+  FetchLimits limits;
+  Fetch fetch;
+  Drained drained;
+
+  mutable std::mutex lock;
+  std::condition_variable wake;
+  // pending uris by host, each in the order pushed
+  std::map<std::string, std::deque<Pending>> pending;
+  // hosts with pending uris and room below max_per_host, by the
+  // sequence of their oldest pending uri
+  std::set<std::pair<size_t, std::string>> ready;
+  // uris waiting to be retried, by the time they are queued again
+  std::multimap<clock::time_point, Pending> delayed;
+  // normalized uris that are pending or being fetched
+  std::unordered_set<std::string> pendingKeys;
+  std::unordered_set<std::string> fetchingKeys;
+  std::map<std::string, size_t> hostInFlight;
+  std::map<std::string, TokenBucket> hostBuckets;
+  TokenBucket global;
+  std::shared_ptr<FetchCounters> counters;
+  size_t sequence;
+  // the uris queued and waiting to be retried
+  size_t pendingCount;
+  size_t inFlight;
+  size_t workers;
+  bool closed;
+  bool canceled;
+
+  TokenBucket& bucket(const std::string& host, clock::time_point now)
+  {
+    auto found = hostBuckets.find(host);
+    if (found == hostBuckets.end()) {
+      found = hostBuckets.insert(std::make_pair(host, TokenBucket(
+        host_rate(limits, host), limits.host_burst, now))).first;
+    }
+    return found->second;
+  }
+
+  // adds work to the pending uris of its host. must hold lock.
+  void enqueue(Pending work)
+  {
+    std::deque<Pending>& queue = pending[work.host];
+    // a host that already had pending uris is either ready or at max_per_host
+    if (queue.empty()) {
+      auto running = hostInFlight.find(work.host);
+      if (running == hostInFlight.end() || running->second < limits.max_per_host) {
+        ready.insert(std::make_pair(work.sequence, work.host));
+      }
+    }
+    queue.push_back(std::move(work));
+  }
+
+  // find the oldest pending uri whose host has room and a token. when
+  // there is none, retry is set to the earliest time a token arrives
+  // or a delayed uri is due. hosts at max_per_host are not in ready, so
+  // only the hosts that may start a uri are visited. must hold lock.
+  bool next(Pending& work, clock::time_point now, clock::time_point& retry)
+  {
+    while (!delayed.empty() && delayed.begin()->first <= now) {
+      enqueue(std::move(delayed.begin()->second));
+      delayed.erase(delayed.begin());
+    }
+    retry = delayed.empty() ? clock::time_point::max() : delayed.begin()->first;
+    if (!global.ready(now)) {
+      retry = std::min(retry, global.ready_at(now));
+      return false;
+    }
+    for (auto cursor = ready.begin(); cursor != ready.end(); ++cursor) {
+      std::deque<Pending>& queue = pending[cursor->second];
+      TokenBucket& host = bucket(cursor->second, now);
+      if (!host.ready(now)) {
+        // the deferred uris of a host are always the oldest ones
+        for (auto uri = queue.rbegin(); uri != queue.rend() && !uri->deferred; ++uri) {
+          uri->deferred = true;
+          ++counters->deferred;
+        }
+        retry = std::min(retry, host.ready_at(now));
+        continue;
+      }
+      host.take(now);
+      global.take(now);
+      work = std::move(queue.front());
+      queue.pop_front();
+      --pendingCount;
+      ready.erase(cursor);
+      ++inFlight;
+      size_t running = ++hostInFlight[work.host];
+      if (queue.empty()) {
+        pending.erase(work.host);
+      } else if (running < limits.max_per_host) {
+        ready.insert(std::make_pair(queue.front().sequence, work.host));
+      }
+      return true;
+    }
+    return false;
+  }
+
+  // a uri of host was fetched, so host may start another one. must
+  // hold lock.
+  void finished(const std::string& host)
+  {
+    auto running = hostInFlight.find(host);
+    size_t was = running->second--;
+    if (running->second == 0) {
+      hostInFlight.erase(running);
+    }
+    auto queue = pending.find(host);
+    if (was == limits.max_per_host && queue != pending.end()) {
+      ready.insert(std::make_pair(queue->second.front().sequence, host));
+    }
+  }
+
+  // drop the buckets of hosts that are idle and full again
+  void prune(clock::time_point now)
+  {
+    if (pendingCount != 0) {
+      return;
+    }
+    for (auto cursor = hostBuckets.begin(); cursor != hostBuckets.end();) {
+      if (!hostInFlight.count(cursor->first) && cursor->second.full(now)) {
+        cursor = hostBuckets.erase(cursor);
+      } else {
+        ++cursor;
+      }
+    }
+  }
+
+  static void worker(std::shared_ptr<Shared> that)
+  {
+    std::unique_lock<std::mutex> guard(that->lock);
+    for (;;) {
+      if (that->canceled || (that->closed && that->pendingCount == 0)) {
+        break;
+      }
+      Pending work;
+      clock::time_point retry;
+      if (!that->next(work, clock::now(), retry)) {
+        if (retry == clock::time_point::max()) {
+          that->wake.wait(guard);
+        } else {
+          that->wake.wait_until(guard, retry);
+        }
+        continue;
+      }
+
+      that->pendingKeys.erase(work.key);
+      that->fetchingKeys.insert(work.key);
+      auto fetch = that->fetch;
+      guard.unlock();
+      clock::duration delay = fetch(work.uri, work.retries);
+      guard.lock();
+      that->fetchingKeys.erase(work.key);
+      --that->inFlight;
+      that->finished(work.host);
+      if (delay > clock::duration::zero() && !that->canceled) {
+        // pushes of the uri were skipped while it was fetched, so it
+        // is not pending already
+        that->pendingKeys.insert(work.key);
+        ++work.retries;
+        work.deferred = false;
+        work.sequence = that->sequence++;
+        ++that->pendingCount;
+        that->delayed.insert(std::make_pair(clock::now() + delay, std::move(work)));
+      }
+      that->prune(clock::now());
+      that->wake.notify_all();
+    }
+
+    // the last worker out reports the drain and releases the
+    // callbacks, which may hold the owner of this queue alive.
+    if (--that->workers == 0) {
+      Drained drained;
+      if (!that->canceled) {
+        drained = std::move(that->drained);
+      }
+      that->fetch = nullptr;
+      that->drained = nullptr;
+      guard.unlock();
+      if (drained) {
+        drained();
+      }
+    }
+  }
+};
+
+FetchQueue::FetchQueue(FetchLimits limits, Fetch fetch, Drained drained, std::shared_ptr<FetchCounters> counters)
+  : shared(std::make_shared<Shared>(limits, std::move(fetch), std::move(drained)))
+{
+  shared->counters = counters ? std::move(counters) : std::make_shared<FetchCounters>();
+  size_t count = std::max<size_t>(1, limits.max_in_flight);
+  shared->limits.max_per_host = std::max<size_t>(1, limits.max_per_host);
+  shared->workers = count;
+  for (size_t cursor = 0; cursor < count; ++cursor) {
+    // workers own a reference to the shared state, so they may
+    // outlive this queue while the last fetches complete.
+    std::thread(&Shared::worker, shared).detach();
+  }
+}
+
+FetchQueue::~FetchQueue()
+{
+  cancel();
+}
+
+void FetchQueue::push(std::string uri)
+{
+  std::unique_lock<std::mutex> guard(shared->lock);
+  if (uri.empty() || shared->closed || shared->canceled) {
+    return;
+  }
+  ++shared->counters->pushed;
+  std::string key = normalize_uri(uri);
+  if (shared->fetchingKeys.count(key)) {
+    ++shared->counters->skipped;
+    return;
+  }
+  if (!shared->pendingKeys.insert(key).second) {
+    ++shared->counters->coalesced;
+    return;
+  }
+  Shared::Pending work;
+  work.sequence = shared->sequence++;
+  work.host = host_key(uri);
+  work.key = std::move(key);
+  work.uri = std::move(uri);
+  ++shared->pendingCount;
+  shared->enqueue(std::move(work));
+  shared->wake.notify_one();
+}
+
+void FetchQueue::close()
+{
+  std::unique_lock<std::mutex> guard(shared->lock);
+  shared->closed = true;
+  shared->wake.notify_all();
+}
+
+void FetchQueue::cancel()
+{
+  std::unique_lock<std::mutex> guard(shared->lock);
+  shared->canceled = true;
+  shared->pending.clear();
+  shared->ready.clear();
+  shared->delayed.clear();
+  shared->pendingCount = 0;
+  shared->pendingKeys.clear();
+  shared->wake.notify_all();
+}
+
+size_t FetchQueue::pending() const
+{
+  std::unique_lock<std::mutex> guard(shared->lock);
+  return shared->pendingCount;
+}
+
+size_t FetchQueue::in_flight() const
+{
+  std::unique_lock<std::mutex> guard(shared->lock);
+  return shared->inFlight;
+}
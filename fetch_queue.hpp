@@ -0,0 +1,145 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+#ifndef ___FETCH_QUEUE_INC__
+#define ___FETCH_QUEUE_INC__
+
+#include <string>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+struct FetchLimits
+{
+  FetchLimits()
+    : max_in_flight(16)
+    , max_per_host(2)
+    , max_decoded(64 * 1024 * 1024)
+    , host_rate(0)
+    , host_burst(1)
+    , global_rate(0)
+    , global_burst(1)
+  {}
+  // number of fetch workers, and so the most requests outstanding at once
+  size_t max_in_flight;
+  // most requests outstanding against a single scheme://host:port
+  size_t max_per_host;
+  // largest body accepted after Content-Encoding is decoded
+  size_t max_decoded;
+  // requests per second started against one host, zero is unlimited
+  double host_rate;
+  double host_burst;
+  // host_rate for particular host names, e.g. "feeds.example.com"
+  std::map<std::string, double> host_rates;
+  // requests per second started in total, zero is unlimited
+  double global_rate;
+  double global_burst;
+};
+
+// returns "scheme://host:port" with the scheme and host lowercased and
+// the default port filled in. used to group requests by origin.
+std::string host_key(const std::string& uri);
+
+// returns the requests per second allowed against host, a host_key(),
+// from the limits' host_rates or else host_rate.
+double host_rate(const FetchLimits& limits, const std::string& host);
+
+// returns uri with the scheme and host lowercased, a default port and
+// the fragment removed and an empty path replaced by "/". escapes of
+// unreserved characters are decoded, the others are uppercased, and
+// "." and ".." segments are removed. two uris that normalize the same
+// fetch the same resource.
+std::string normalize_uri(const std::string& uri);
+
+// returns normalize_uri(uri) without the scheme or a trailing "/" on
+// the path. two uris with the same key are taken to be the same feed,
+// e.g. "http://Example.com/feed/" and "https://example.com/feed".
+std::string feed_key(const std::string& uri);
+
+// counts of the uris pushed into FetchQueue. may be shared by several
+// queues and read while they run.
+struct FetchCounters
+{
+  FetchCounters() : pushed(0), coalesced(0), skipped(0), deferred(0) {}
+  std::atomic<size_t> pushed;
+  // pushed while the same uri was waiting in the queue
+  std::atomic<size_t> coalesced;
+  // pushed while the same uri was being fetched
+  std::atomic<size_t> skipped;
+  // uris passed over because their host was out of tokens
+  std::atomic<size_t> deferred;
+};
+
+// runs fetch(uri) for each pushed uri on a fixed set of worker threads.
+// a uri is only started when its host is below max_per_host and the
+// host's token bucket has a token, later uris for other hosts are
+// started ahead of it meanwhile. no uri is started while the global
+// token bucket is empty.
+//
+// a uri that normalizes the same as one already queued is coalesced
+// into the queued one, and one that is being fetched is skipped.
+//
+// fetch returns the delay before the uri is to be fetched again, when
+// the attempt is to be retried, or zero when it is done. a uri waiting
+// to be retried holds no worker and is coalesced like a queued one.
+class FetchQueue
+{
+public:
+  typedef std::chrono::steady_clock clock;
+  // retry is the number of attempts at uri before this one
+  typedef std::function<clock::duration(const std::string& uri, size_t retry)> Fetch;
+  typedef std::function<void()> Drained;
+
+
+  FetchQueue(FetchLimits limits, Fetch fetch, Drained drained,
+      std::shared_ptr<FetchCounters> counters = std::shared_ptr<FetchCounters>());
+  ~FetchQueue();
+
+  void push(std::string uri);
+
+  // no more uris will be pushed. drained() is called once the
+  // pending uris, and their retries, have all been fetched.
+  void close();
+
+  // drop the pending uris and stop the workers as soon as the
+  // fetches in flight return. drained() is not called.
+  void cancel();
+
+  size_t pending() const;
+  size_t in_flight() const;
+
+private:
+  FetchQueue(const FetchQueue&);
+  FetchQueue& operator=(const FetchQueue&);
+
+  struct Shared;
+  std::shared_ptr<Shared> shared;
+};
+
+#endif  // ___FETCH_QUEUE_INC__
@@ -0,0 +1,1729 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "http_reactor.hpp"
+#include "fetch_queue.hpp"
+#include "resolver_cache.hpp"
+#include "tls_session.hpp"
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#if defined(ALLUP_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock clock;
+
+bool same_name(const std::string& lhs, const std::string& rhs)
+{
+  return lhs.size() == rhs.size() &&
+    std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char l, char r) {
+      return ::tolower(static_cast<unsigned char>(l)) == ::tolower(static_cast<unsigned char>(r));
+    });
+}
+
+std::string trim(const std::string& text)
+{
+  std::string::size_type first = text.find_first_not_of(" \t");
+  if (first == std::string::npos) {
+    return std::string();
+  }
+  return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
+
+std::string error_text(int error)
+{
+  return std::strerror(error);
+}
+
+//
+// backends. each socket has at most one operation outstanding, the
+// result is reported as a completion the way a system call would return
+// it: the byte count or zero on success and -errno on failure.
+//
+
+struct IoCompletion
+{
+  std::uint64_t token;
+  int result;
+};
+
+class IoBackend
+{
+public:
+  explicit IoBackend(ReactorCounters& c) : counters(c) {}
+  virtual ~IoBackend() {}
+
+  virtual const char* name() const = 0;
+  virtual void connect(int fd, const sockaddr* address, socklen_t length, std::uint64_t token) = 0;
+  virtual void send(int fd, const char* data, size_t size, std::uint64_t token) = 0;
+  virtual void recv(int fd, char* data, size_t size, std::uint64_t token) = 0;
+  // the socket is about to be closed, busy when an operation is
+  // outstanding. returns true when a completion will still be delivered.
+  virtual bool abandon(int fd, bool busy) = 0;
+  // submits the queued operations and waits up to timeout for completions
+  virtual void wait(clock::duration timeout, std::vector<IoCompletion>& done) = 0;
+  // thread-safe, interrupts wait
+  virtual void wake() = 0;
+
+protected:
+  ReactorCounters& counters;
+};
+
+// readiness based. operations are attempted as soon as they are queued
+// and parked until epoll reports the socket ready when they would block.
+// sockets are registered edge-triggered once, so no epoll_ctl is needed
+// per operation.
+class EpollBackend : public IoBackend
+{
+public:
+  explicit EpollBackend(ReactorCounters& c)
+    : IoBackend(c)
+    , poller(::epoll_create1(EPOLL_CLOEXEC))
+    , waker(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {
+    counters.syscalls += 2;
+    if (poller < 0 || waker < 0) {
+      throw std::runtime_error("epoll: " + error_text(errno));
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = waker;
+    ::epoll_ctl(poller, EPOLL_CTL_ADD, waker, &event);
+    ++counters.syscalls;
+  }
+  ~EpollBackend()
+  {
+    ::close(waker);
+    ::close(poller);
+  }
+
+  const char* name() const { return "epoll"; }
+
+  void connect(int fd, const sockaddr* address, socklen_t length, std::uint64_t token)
+  {
+    Socket& socket = watch(fd);
+    ++counters.submissions;
+    ++counters.syscalls;
+    if (::connect(fd, address, length) == 0) {
+      socket.writable = true;
+      ready.push_back(IoCompletion{token, 0});
+    } else if (errno == EINPROGRESS) {
+      socket.op = Socket::connecting;
+      socket.token = token;
+    } else {
+      ready.push_back(IoCompletion{token, -errno});
+    }
+  }
+
+  void send(int fd, const char* data, size_t size, std::uint64_t token)
+  {
+    Socket& socket = watch(fd);
+    ++counters.submissions;
+    socket.op = Socket::sending;
+    socket.token = token;
+    socket.data = const_cast<char*>(data);
+    socket.size = size;
+    attempt(fd, socket);
+  }
+
+  void recv(int fd, char* data, size_t size, std::uint64_t token)
+  {
+    Socket& socket = watch(fd);
+    ++counters.submissions;
+    socket.op = Socket::receiving;
+    socket.token = token;
+    socket.data = data;
+    socket.size = size;
+    attempt(fd, socket);
+  }
+
+  bool abandon(int fd, bool)
+  {
+    // close() removes the socket from the epoll set
+    sockets.erase(fd);
+    return false;
+  }
+
+  void wait(clock::duration timeout, std::vector<IoCompletion>& done)
+  {
+    if (!ready.empty()) {
+      timeout = clock::duration::zero();
+    }
+    epoll_event events[256];
+    int milliseconds = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+      timeout + std::chrono::microseconds(999)).count());
+    int count = ::epoll_wait(poller, events, 256, milliseconds);
+    ++counters.syscalls;
+    for (int cursor = 0; cursor < count; ++cursor) {
+      int fd = events[cursor].data.fd;
+      if (fd == waker) {
+        std::uint64_t value;
+        if (::read(waker, &value, sizeof(value)) < 0) {}
+        ++counters.syscalls;
+        continue;
+      }
+      auto found = sockets.find(fd);
+      if (found == sockets.end()) {
+        continue;
+      }
+      Socket& socket = found->second;
+      std::uint32_t flags = events[cursor].events;
+      if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        socket.readable = true;
+      }
+      if (flags & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        socket.hangup = true;
+      }
+      if (flags & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+        socket.writable = true;
+      }
+      attempt(fd, socket);
+    }
+    done.insert(done.end(), ready.begin(), ready.end());
+    ready.clear();
+  }
+
+  void wake()
+  {
+    std::uint64_t value = 1;
+    if (::write(waker, &value, sizeof(value)) < 0) {}
+    ++counters.syscalls;
+  }
+
+private:
+  struct Socket
+  {
+    enum Op { idle, connecting, sending, receiving };
+    Socket() : op(idle), token(0), data(nullptr), size(0), readable(false), writable(false), hangup(false) {}
+    Op op;
+    std::uint64_t token;
+    char* data;
+    size_t size;
+    // last known readiness, cleared when a call would block
+    bool readable;
+    bool writable;
+    // the peer closed or the socket failed, no further edge will come
+    bool hangup;
+  };
+
+  Socket& watch(int fd)
+  {
+    auto found = sockets.find(fd);
+    if (found == sockets.end()) {
+      epoll_event event = {};
+      event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+      event.data.fd = fd;
+      ::epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event);
+      ++counters.syscalls;
+      found = sockets.insert(std::make_pair(fd, Socket())).first;
+    }
+    return found->second;
+  }
+
+  void complete(Socket& socket, int result)
+  {
+    ready.push_back(IoCompletion{socket.token, result});
+    socket.op = Socket::idle;
+  }
+
+  void attempt(int fd, Socket& socket)
+  {
+    switch (socket.op) {
+    case Socket::idle:
+      break;
+    case Socket::connecting:
+      if (socket.writable) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        ++counters.syscalls;
+        complete(socket, -error);
+      }
+      break;
+    case Socket::sending:
+      if (socket.writable) {
+        ssize_t sent = ::send(fd, socket.data, socket.size, MSG_NOSIGNAL);
+        ++counters.syscalls;
+        if (sent >= 0) {
+          complete(socket, static_cast<int>(sent));
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          socket.writable = false;
+        } else {
+          complete(socket, -errno);
+        }
+      }
+      break;
+    case Socket::receiving:
+      if (socket.readable) {
+        ssize_t received = ::recv(fd, socket.data, socket.size, 0);
+        ++counters.syscalls;
+        if (received >= 0) {
+          // a short read drained the socket, the next arrival is a new edge
+          if (received > 0 && static_cast<size_t>(received) < socket.size && !socket.hangup) {
+            socket.readable = false;
+          }
+          complete(socket, static_cast<int>(received));
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          socket.readable = false;
+        } else {
+          complete(socket, -errno);
+        }
+      }
+      break;
+    }
+  }
+
+  int poller;
+  int waker;
+  std::map<int, Socket> sockets;
+  std::vector<IoCompletion> ready;
+};
+
+#if defined(ALLUP_HAVE_IO_URING)
+
+// completion based. operations are written to the submission ring and
+// handed to the kernel together with the wait, so one io_uring_enter
+// covers every connect, send and recv queued since the last one.
+class UringBackend : public IoBackend
+{
+public:
+  explicit UringBackend(ReactorCounters& c)
+    : IoBackend(c)
+    , ring(-1)
+    , waker(::eventfd(0, EFD_CLOEXEC))
+    , queued(0)
+    , timerArmed(false)
+    , timerDeadline(clock::time_point::max())
+    , wakeArmed(false)
+  {
+    ++counters.syscalls;
+    io_uring_params params = {};
+    ring = static_cast<int>(::syscall(__NR_io_uring_setup, 1024, &params));
+    ++counters.syscalls;
+    if (ring < 0 || waker < 0) {
+      int error = errno;
+      if (waker >= 0) {
+        ::close(waker);
+      }
+      if (ring >= 0) {
+        ::close(ring);
+      }
+      throw std::runtime_error("io_uring: " + error_text(error));
+    }
+    // a ring can be set up on kernels that lack some of the operations,
+    // they would only fail as each is submitted
+    std::string missing = unsupported();
+    if (!missing.empty()) {
+      ::close(ring);
+      ::close(waker);
+      throw std::runtime_error("io_uring: " + missing + " not supported by the kernel");
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+      sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+    sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+    cqRing = single ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(map(sqesSize, IORING_OFF_SQES));
+
+    char* sq = static_cast<char*>(sqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cqRing);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+
+  ~UringBackend()
+  {
+    ::munmap(sqes, sqesSize);
+    if (cqRing != sqRing) {
+      ::munmap(cqRing, cqRingSize);
+    }
+    ::munmap(sqRing, sqRingSize);
+    ::close(ring);
+    ::close(waker);
+  }
+
+  const char* name() const { return "io_uring"; }
+
+  void connect(int fd, const sockaddr* address, socklen_t length, std::uint64_t token)
+  {
+    io_uring_sqe* sqe = next();
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(address);
+    sqe->off = length;
+    sqe->user_data = token;
+  }
+
+  void send(int fd, const char* data, size_t size, std::uint64_t token)
+  {
+    io_uring_sqe* sqe = next();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(data);
+    sqe->len = static_cast<unsigned>(size);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = token;
+  }
+
+  void recv(int fd, char* data, size_t size, std::uint64_t token)
+  {
+    io_uring_sqe* sqe = next();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(data);
+    sqe->len = static_cast<unsigned>(size);
+    sqe->user_data = token;
+  }
+
+  bool abandon(int fd, bool busy)
+  {
+    // the kernel holds its own reference to the socket, shutting it
+    // down ends the outstanding operation, which still completes.
+    if (busy) {
+      ::shutdown(fd, SHUT_RDWR);
+      ++counters.syscalls;
+    }
+    return busy;
+  }
+
+  void wait(clock::duration timeout, std::vector<IoCompletion>& done)
+  {
+    if (!wakeArmed) {
+      io_uring_sqe* sqe = next();
+      sqe->opcode = IORING_OP_READ;
+      sqe->fd = waker;
+      sqe->addr = reinterpret_cast<std::uint64_t>(&wakeValue);
+      sqe->len = sizeof(wakeValue);
+      sqe->user_data = wake_token;
+      wakeArmed = true;
+    }
+    auto deadline = clock::now() + timeout;
+    bool earlier = deadline + std::chrono::milliseconds(1) < timerDeadline;
+    if (timeout > clock::duration::zero() && (!timerArmed || earlier)) {
+      if (timerArmed) {
+        // the armed timeout would overshoot a deadline that came in
+        // since, it is cancelled and replaced. the kernel matches the
+        // removal before the timeout after it is queued.
+        io_uring_sqe* sqe = next();
+        sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = timer_token;
+        sqe->user_data = timer_remove_token;
+      }
+      auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+      timerValue.tv_sec = nanoseconds / 1000000000;
+      timerValue.tv_nsec = nanoseconds % 1000000000;
+      io_uring_sqe* sqe = next();
+      sqe->opcode = IORING_OP_TIMEOUT;
+      sqe->fd = -1;
+      sqe->addr = reinterpret_cast<std::uint64_t>(&timerValue);
+      sqe->len = 1;
+      sqe->user_data = timer_token;
+      timerArmed = true;
+      timerDeadline = deadline;
+    }
+
+    bool waiting = timeout > clock::duration::zero() && pending() == 0;
+    enter(waiting ? 1 : 0);
+
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const io_uring_cqe& cqe = cqes[head & cqMask];
+      if (cqe.user_data == wake_token) {
+        wakeArmed = false;
+      } else if (cqe.user_data == timer_token) {
+        // a replaced timeout completes as canceled, the one that
+        // replaced it is still armed
+        if (cqe.res != -ECANCELED) {
+          timerArmed = false;
+          timerDeadline = clock::time_point::max();
+        }
+      } else if (cqe.user_data == timer_remove_token) {
+        // the timeout it removed completes on its own
+      } else {
+        done.push_back(IoCompletion{cqe.user_data, cqe.res});
+      }
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+  }
+
+  void wake()
+  {
+    std::uint64_t value = 1;
+    if (::write(waker, &value, sizeof(value)) < 0) {}
+    ++counters.syscalls;
+  }
+
+private:
+  static const std::uint64_t wake_token = ~std::uint64_t(0);
+  static const std::uint64_t timer_token = ~std::uint64_t(0) - 1;
+  static const std::uint64_t timer_remove_token = ~std::uint64_t(0) - 2;
+
+  // the operations submitted that the kernel does not support, by
+  // name, or empty when it supports them all
+  std::string unsupported()
+  {
+    static const struct {
+      std::uint8_t opcode;
+      const char* name;
+    } used[] = {
+      {IORING_OP_CONNECT, "connect"},
+      {IORING_OP_SEND, "send"},
+      {IORING_OP_RECV, "recv"},
+      {IORING_OP_READ, "read"},
+      {IORING_OP_TIMEOUT, "timeout"},
+      {IORING_OP_TIMEOUT_REMOVE, "timeout_remove"}};
+    const unsigned count = 256;
+    std::vector<char> buffer(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op));
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+    int result = static_cast<int>(::syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, count));
+    ++counters.syscalls;
+    if (result < 0) {
+      // probing came with 5.6, the kernels before it lack some of them
+      return "probing operations";
+    }
+    std::string missing;
+    for (auto& op : used) {
+      if (op.opcode > probe->last_op || !(probe->ops[op.opcode].flags & IO_URING_OP_SUPPORTED)) {
+        missing += missing.empty() ? op.name : std::string(", ") + op.name;
+      }
+    }
+    return missing;
+  }
+
+  void* map(size_t size, off_t offset)
+  {
+    void* mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, offset);
+    ++counters.syscalls;
+    if (mapped == MAP_FAILED) {
+      throw std::runtime_error("io_uring: " + error_text(errno));
+    }
+    return mapped;
+  }
+
+  unsigned pending() const
+  {
+    return *cqTail - *cqHead;
+  }
+
+  // a cleared submission slot, flushing the ring first when it is full
+  io_uring_sqe* next()
+  {
+    if (queued == sqEntries) {
+      enter(0);
+    }
+    unsigned tail = *sqTail + queued;
+    unsigned index = tail & sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    ++queued;
+    ++counters.submissions;
+    return sqe;
+  }
+
+  void enter(unsigned minimum)
+  {
+    __atomic_store_n(sqTail, *sqTail + queued, __ATOMIC_RELEASE);
+    unsigned submit = queued;
+    queued = 0;
+    for (;;) {
+      int entered = static_cast<int>(::syscall(__NR_io_uring_enter, ring, submit, minimum,
+        minimum ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+      ++counters.syscalls;
+      if (entered >= 0 || errno != EINTR) {
+        break;
+      }
+    }
+  }
+
+  int ring;
+  int waker;
+  unsigned queued;
+  bool timerArmed;
+  clock::time_point timerDeadline;
+  bool wakeArmed;
+  std::uint64_t wakeValue;
+  __kernel_timespec timerValue;
+
+  size_t sqRingSize;
+  size_t cqRingSize;
+  size_t sqesSize;
+  void* sqRing;
+  void* cqRing;
+  io_uring_sqe* sqes;
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned sqMask;
+  unsigned sqEntries;
+  unsigned* sqArray;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned cqMask;
+  io_uring_cqe* cqes;
+};
+
+#endif
+
+//
+// an incremental HTTP/1.1 response parser
+//
+
+class ResponseParser
+{
+public:
+  enum State { status_line, header_lines, body_sized, chunk_size, chunk_data, chunk_end, trailer_lines, body_to_close, complete, invalid };
+
+  ResponseParser() { reset(); }
+
+  void reset()
+  {
+    state = status_line;
+    remaining = 0;
+    keepAlive = true;
+    line.clear();
+    error.clear();
+  }
+
+  // consumes data into result, returns the state reached
+  State feed(const char* data, size_t size, HttpResult& result, size_t max_body)
+  {
+    const char* end = data + size;
+    while (data != end && state != complete && state != invalid) {
+      switch (state) {
+      case body_sized: {
+        size_t take = std::min<size_t>(remaining, end - data);
+        result.body.append(data, take);
+        data += take;
+        remaining -= take;
+        if (remaining == 0) {
+          state = complete;
+        }
+        break;
+      }
+      case chunk_data: {
+        size_t take = std::min<size_t>(remaining, end - data);
+        result.body.append(data, take);
+        data += take;
+        remaining -= take;
+        if (remaining == 0) {
+          state = chunk_end;
+        }
+        break;
+      }
+      case body_to_close:
+        result.body.append(data, end);
+        data = end;
+        break;
+      default: {
+        const char* newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+        if (!newline) {
+          line.append(data, end);
+          data = end;
+          if (line.size() > 64 * 1024) {
+            fail("header line too long");
+          }
+          break;
+        }
+        line.append(data, newline);
+        data = newline + 1;
+        if (!line.empty() && line.back() == '\r') {
+          line.pop_back();
+        }
+        on_line(result);
+        line.clear();
+        break;
+      }
+      }
+      if (result.body.size() > max_body) {
+        fail("body larger than " + std::to_string(max_body) + " bytes");
+      }
+    }
+    return state;
+  }
+
+  // the connection closed, which ends a body that runs to the close
+  State closed()
+  {
+    if (state == body_to_close) {
+      state = complete;
+      keepAlive = false;
+    } else if (state != complete) {
+      fail("connection closed before the response was complete");
+    }
+    return state;
+  }
+
+  State current() const { return state; }
+  bool started() const { return state != status_line || !line.empty(); }
+  bool keep_alive() const { return keepAlive; }
+  const std::string& failure() const { return error; }
+
+private:
+  void fail(std::string reason)
+  {
+    state = invalid;
+    error = std::move(reason);
+  }
+
+  void on_line(HttpResult& result)
+  {
+    switch (state) {
+    case status_line: {
+      // HTTP/1.1 200 OK
+      if (line.compare(0, 5, "HTTP/") != 0) {
+        return fail("not an http response");
+      }
+      std::string::size_type space = line.find(' ');
+      if (space == std::string::npos) {
+        return fail("malformed status line");
+      }
+      keepAlive = line.compare(0, space, "HTTP/1.0") != 0;
+      result.status = static_cast<std::uint16_t>(std::atoi(line.c_str() + space + 1));
+      std::string::size_type reason = line.find(' ', space + 1);
+      result.message = reason == std::string::npos ? std::string() : line.substr(reason + 1);
+      result.headers.clear();
+      state = header_lines;
+      break;
+    }
+    case header_lines:
+      if (line.empty()) {
+        return on_headers(result);
+      } else {
+        std::string::size_type colon = line.find(':');
+        if (colon == std::string::npos) {
+          return fail("malformed header");
+        }
+        result.headers.push_back(std::make_pair(line.substr(0, colon), trim(line.substr(colon + 1))));
+      }
+      break;
+    case chunk_size: {
+      char* last = nullptr;
+      remaining = std::strtoull(line.c_str(), &last, 16);
+      if (last == line.c_str()) {
+        return fail("malformed chunk size");
+      }
+      state = remaining == 0 ? trailer_lines : chunk_data;
+      break;
+    }
+    case chunk_end:
+      if (!line.empty()) {
+        return fail("malformed chunk");
+      }
+      state = chunk_size;
+      break;
+    case trailer_lines:
+      if (line.empty()) {
+        state = complete;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  void on_headers(HttpResult& result)
+  {
+    // interim responses are followed by the real one
+    if (result.status >= 100 && result.status < 200) {
+      state = status_line;
+      return;
+    }
+    std::string connection = result.header("Connection");
+    std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+    if (connection.find("close") != std::string::npos) {
+      keepAlive = false;
+    } else if (connection.find("keep-alive") != std::string::npos) {
+      keepAlive = true;
+    }
+
+    std::string encoding = result.header("Transfer-Encoding");
+    std::string length = result.header("Content-Length");
+    if (result.status == 204 || result.status == 304) {
+      state = complete;
+    } else if (!encoding.empty() && encoding != "identity") {
+      state = chunk_size;
+    } else if (!length.empty()) {
+      remaining = std::strtoull(length.c_str(), nullptr, 10);
+      state = remaining == 0 ? complete : body_sized;
+    } else {
+      state = body_to_close;
+      keepAlive = false;
+    }
+  }
+
+  State state;
+  unsigned long long remaining;
+  bool keepAlive;
+  std::string line;
+  std::string error;
+};
+
+struct Target
+{
+  Target() : secure(false) {}
+  // https
+  bool secure;
+  std::string host;
+  std::string port;
+  // host header and request target
+  std::string authority;
+  std::string path;
+};
+
+bool parse_target(const std::string& uri, Target& target, std::string& error)
+{
+  std::string key = host_key(uri);
+  target.secure = key.compare(0, 8, "https://") == 0;
+  if (!target.secure && key.compare(0, 7, "http://") != 0) {
+    error = "only http and https uris are supported by the reactor";
+    return false;
+  }
+  std::string::size_type origin = target.secure ? 8 : 7;
+  std::string::size_type colon = key.rfind(':');
+  target.host = key.substr(origin, colon - origin);
+  target.port = key.substr(colon + 1);
+  if (!target.host.empty() && target.host[0] == '[') {
+    target.host = target.host.substr(1, target.host.size() - 2);
+  }
+
+  std::string normal = normalize_uri(uri);
+  std::string::size_type path = normal.find('/', origin);
+  target.authority = normal.substr(origin, path - origin);
+  std::string::size_type at = target.authority.rfind('@');
+  if (at != std::string::npos) {
+    target.authority.erase(0, at + 1);
+  }
+  target.path = normal.substr(path);
+  return true;
+}
+
+}
+
+std::string HttpResult::header(const std::string& name) const
+{
+  std::string value;
+  for (auto& header : headers) {
+    if (same_name(header.first, name)) {
+      value = header.second;
+    }
+  }
+  return value;
+}
+
+struct HttpReactor::Loop
+{
+  struct Lookup;
+  // the requests handed to the resolver, by deadline
+  typedef std::multimap<clock::time_point, std::shared_ptr<Lookup>> Lookups;
+
+  struct Request
+  {
+    HttpRequest request;
+    Completion completion;
+    Target target;
+    std::string host;
+    clock::time_point notBefore;
+    // set once target.host has been looked up
+    bool resolved;
+    Resolution resolution;
+    // the address of resolution that is connected to. the next one is
+    // tried when connecting fails.
+    size_t address;
+    // the deadlines, set as the request is admitted and kept while its
+    // host is looked up and as it moves on to the next address
+    clock::time_point firstByteBy;
+    clock::time_point doneBy;
+    // its entry in resolving while the host is looked up
+    Lookups::iterator lookup;
+  };
+
+  // a request waiting for its host to be looked up. the answer and the
+  // deadline race for it, whichever takes it first finishes it.
+  struct Lookup
+  {
+    std::mutex lock;
+    std::unique_ptr<Request> request;
+
+    std::unique_ptr<Request> take()
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      return std::move(request);
+    }
+  };
+
+  // the requests handed to the reactor thread by other threads
+  struct Inbox
+  {
+    Inbox() : stopping(false), io(nullptr) {}
+    std::mutex lock;
+    std::vector<std::unique_ptr<Request>> submitted;
+    std::vector<std::unique_ptr<Request>> resolved;
+    bool stopping;
+    IoBackend* io;
+
+    // false once the reactor is stopping, request is left with the caller
+    bool post(std::vector<std::unique_ptr<Request>>& to, std::unique_ptr<Request>& request)
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      if (stopping) {
+        return false;
+      }
+      to.push_back(std::move(request));
+      io->wake();
+      return true;
+    }
+  };
+
+  struct Connection
+  {
+    enum Phase { idle, connecting, handshaking, sending, receiving };
+    enum Op { connect_op, send_op, recv_op };
+    Connection()
+      : fd(-1), generation(0), phase(idle), op(connect_op), reused(false), busy(false), orphaned(false)
+      , sent(0), received(0), progressed(0)
+    {}
+    int fd;
+    std::uint32_t generation;
+    Phase phase;
+    // the operation outstanding, or last completed
+    Op op;
+    std::string host;
+    sockaddr_storage address;
+    socklen_t addressLength;
+    bool reused;
+    // an operation is outstanding in the backend
+    bool busy;
+    // closed with an operation still outstanding in the backend
+    bool orphaned;
+    std::unique_ptr<Request> request;
+    // the request, and the bytes being sent, which for https are
+    // handshake records or the request encrypted
+    std::string message;
+    std::string wire;
+    std::unique_ptr<TlsSession> tls;
+    size_t sent;
+    size_t received;
+    // body bytes passed to the request's progress
+    size_t progressed;
+    std::unique_ptr<char[]> buffer;
+    ResponseParser parser;
+    HttpResult result;
+    clock::time_point firstByteBy;
+    clock::time_point doneBy;
+    clock::time_point idleSince;
+  };
+
+  Loop(HttpReactorLimits l, Backend backend, std::shared_ptr<ResolverCache> r, std::shared_ptr<TlsContext> t)
+    : limits(l)
+    , resolver(r ? std::move(r) : std::make_shared<ResolverCache>())
+    , tls(t ? std::move(t) : std::make_shared<TlsContext>())
+    , inbox(std::make_shared<Inbox>())
+    , inFlight(0)
+    , nextDeadline(clock::time_point::max())
+    , nextStart(clock::time_point::max())
+  {
+    limits.max_in_flight = std::max<size_t>(1, limits.max_in_flight);
+    limits.max_per_host = std::max<size_t>(1, limits.max_per_host);
+    limits.buffer_size = std::max<size_t>(512, limits.buffer_size);
+    plain.reset(new char[limits.buffer_size]);
+#if defined(ALLUP_HAVE_IO_URING)
+    if (backend != epoll) {
+      try {
+        io.reset(new UringBackend(counters));
+      } catch (const std::exception&) {
+        if (backend == io_uring) {
+          throw;
+        }
+      }
+    }
+#else
+    if (backend == io_uring) {
+      throw std::runtime_error("io_uring: not supported by this build");
+    }
+#endif
+    if (!io) {
+      io.reset(new EpollBackend(counters));
+    }
+    inbox->io = io.get();
+    thread = std::thread(&Loop::run, this);
+  }
+
+  ~Loop()
+  {
+    {
+      std::unique_lock<std::mutex> guard(inbox->lock);
+      inbox->stopping = true;
+      io->wake();
+    }
+    thread.join();
+  }
+
+  static void cancel(std::unique_ptr<Request> request)
+  {
+    HttpResult result;
+    result.uri = request->request.uri;
+    result.error = "canceled";
+    request->completion(std::move(result));
+  }
+
+  HttpReactorLimits limits;
+  ReactorCounters counters;
+  std::shared_ptr<ResolverCache> resolver;
+  std::shared_ptr<TlsContext> tls;
+  std::unique_ptr<IoBackend> io;
+  std::shared_ptr<Inbox> inbox;
+  std::thread thread;
+
+  // reactor thread only
+  // requests not started yet: held until their notBefore, then ready
+  // in the order they came due, or held back by their host's limit until
+  // one of its requests is done
+  std::multimap<clock::time_point, std::unique_ptr<Request>> delayed;
+  std::deque<std::unique_ptr<Request>> ready;
+  std::map<std::string, std::deque<std::unique_ptr<Request>>> blocked;
+  Lookups resolving;
+  std::map<std::string, size_t> hostInFlight;
+  std::map<std::string, std::vector<size_t>> idle;
+  // the connections as they were parked, oldest first. an entry is stale
+  // once its connection was reused or closed.
+  struct Parked
+  {
+    clock::time_point since;
+    size_t index;
+    std::uint32_t generation;
+  };
+  std::deque<Parked> parkedOrder;
+  // a deque, the backend holds pointers into connections as they grow
+  std::deque<Connection> connections;
+  std::vector<size_t> unused;
+  std::vector<std::unique_ptr<char[]>> buffers;
+  // decrypted https responses are read through here
+  std::unique_ptr<char[]> plain;
+  size_t inFlight;
+  // the earliest deadline of the requests in flight, or later
+  clock::time_point nextDeadline;
+  // the earliest start of a delayed request
+  clock::time_point nextStart;
+
+  static std::uint64_t token(size_t index, std::uint32_t generation)
+  {
+    return (static_cast<std::uint64_t>(generation) << 32) | index;
+  }
+
+  void run()
+  {
+    std::vector<IoCompletion> done;
+    std::vector<std::unique_ptr<Request>> resolved;
+    for (;;) {
+      bool stop;
+      {
+        std::unique_lock<std::mutex> guard(inbox->lock);
+        stop = inbox->stopping;
+        for (auto& request : inbox->submitted) {
+          clock::time_point notBefore = request->notBefore;
+          delayed.insert(std::make_pair(notBefore, std::move(request)));
+        }
+        inbox->submitted.clear();
+        resolved.swap(inbox->resolved);
+      }
+      auto now = clock::now();
+      for (auto& request : resolved) {
+        resolving.erase(request->lookup);
+        if (stop) {
+          ++counters.failed;
+          cancel(std::move(request));
+        } else if (now >= std::min(request->firstByteBy, request->doneBy)) {
+          lookup_expired(std::move(request));
+        } else if (!request->resolution.error.empty()) {
+          std::string error = request->resolution.error;
+          release_host(request->host);
+          finish(std::move(request), std::move(error));
+        } else {
+          start(std::move(request), now);
+        }
+      }
+      resolved.clear();
+      if (stop) {
+        break;
+      }
+      admit(now);
+      expire(now);
+      sweep(now);
+
+      done.clear();
+      clock::duration timeout = std::chrono::milliseconds(50);
+      auto next = std::min(nextDeadline, nextStart);
+      if (!resolving.empty()) {
+        next = std::min(next, resolving.begin()->first);
+      }
+      if (next != clock::time_point::max()) {
+        timeout = std::max(clock::duration::zero(), std::min(timeout, next - now));
+      }
+      io->wait(timeout, done);
+      for (auto& completion : done) {
+        size_t index = static_cast<size_t>(completion.token & 0xffffffff);
+        std::uint32_t generation = static_cast<std::uint32_t>(completion.token >> 32);
+        if (index < connections.size() && connections[index].generation == generation) {
+          try {
+            on_completion(index, completion.result);
+          } catch (const std::exception& e) {
+            // tls failures
+            fail(index, e.what(), false);
+          }
+        }
+      }
+    }
+
+    for (size_t index = 0; index < connections.size(); ++index) {
+      if (connections[index].request) {
+        fail(index, "canceled", false);
+      }
+    }
+    for (auto& lookup : resolving) {
+      // the answer, when it comes, finds the request gone
+      std::unique_ptr<Request> request = lookup.second->take();
+      if (request) {
+        ++counters.failed;
+        cancel(std::move(request));
+      }
+    }
+    resolving.clear();
+    for (auto& request : delayed) {
+      ++counters.failed;
+      cancel(std::move(request.second));
+    }
+    for (auto& request : ready) {
+      ++counters.failed;
+      cancel(std::move(request));
+    }
+    for (auto& host : blocked) {
+      for (auto& request : host.second) {
+        ++counters.failed;
+        cancel(std::move(request));
+      }
+    }
+    delayed.clear();
+    ready.clear();
+    blocked.clear();
+    for (auto& connection : connections) {
+      if (connection.fd >= 0) {
+        ::close(connection.fd);
+      }
+    }
+  }
+
+  // starts the requests that are due, as far as the limits allow. only
+  // the requests that came due and those that can start are touched,
+  // the rest wait in delayed or blocked.
+  void admit(clock::time_point now)
+  {
+    while (!delayed.empty() && delayed.begin()->first <= now) {
+      ready.push_back(std::move(delayed.begin()->second));
+      delayed.erase(delayed.begin());
+    }
+    nextStart = delayed.empty() ? clock::time_point::max() : delayed.begin()->first;
+    while (!ready.empty() && inFlight < limits.max_in_flight) {
+      std::unique_ptr<Request> work = std::move(ready.front());
+      ready.pop_front();
+      size_t& host = hostInFlight[work->host];
+      if (host >= limits.max_per_host) {
+        blocked[work->host].push_back(std::move(work));
+        continue;
+      }
+      ++host;
+      ++inFlight;
+      ++counters.requests;
+      work->firstByteBy = now + work->request.first_byte;
+      work->doneBy = now + work->request.total;
+      start(std::move(work), now);
+    }
+  }
+
+  size_t allocate()
+  {
+    if (!unused.empty()) {
+      size_t index = unused.back();
+      unused.pop_back();
+      return index;
+    }
+    connections.push_back(Connection());
+    return connections.size() - 1;
+  }
+
+  std::unique_ptr<char[]> buffer()
+  {
+    if (buffers.empty()) {
+      return std::unique_ptr<char[]>(new char[limits.buffer_size]);
+    }
+    std::unique_ptr<char[]> reused = std::move(buffers.back());
+    buffers.pop_back();
+    return reused;
+  }
+
+  // an idle keep-alive connection to host, or a new one
+  size_t connection_for(const std::string& host, clock::time_point now)
+  {
+    auto found = idle.find(host);
+    while (found != idle.end()) {
+      size_t index = found->second.back();
+      found->second.pop_back();
+      if (found->second.empty()) {
+        idle.erase(found);
+        found = idle.end();
+      }
+      Connection& connection = connections[index];
+      if (now - connection.idleSince < limits.idle_timeout) {
+        connection.reused = true;
+        ++counters.reused;
+        return index;
+      }
+      close(index);
+    }
+    return connections.size();
+  }
+
+  void start(std::unique_ptr<Request> request, clock::time_point now)
+  {
+    size_t index = connection_for(request->host, now);
+    if (index == connections.size() && !request->resolved) {
+      // looked up on the resolver's threads, or right away when cached.
+      // the request comes back through the inbox either way, unless its
+      // deadline passed first.
+      auto lookup = std::make_shared<Lookup>();
+      request->lookup = resolving.insert(std::make_pair(std::min(request->firstByteBy, request->doneBy), lookup));
+      std::string host = request->target.host;
+      lookup->request = std::move(request);
+      auto to = inbox;
+      resolver->resolve(host, [lookup, to](const Resolution& resolution){
+        std::unique_ptr<Request> request = lookup->take();
+        if (!request) {
+          return;
+        }
+        request->resolved = true;
+        request->resolution = resolution;
+        if (!to->post(to->resolved, request)) {
+          cancel(std::move(request));
+        }
+      });
+      return;
+    }
+    if (index == connections.size() && request->address >= request->resolution.addresses.size()) {
+      std::string error = "resolve " + request->target.host + ": no addresses";
+      release_host(request->host);
+      return finish(std::move(request), std::move(error));
+    }
+    if (index == connections.size()) {
+      const sockaddr_storage& found = request->resolution.addresses[request->address];
+      int fd = ::socket(found.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      ++counters.syscalls;
+      if (fd < 0) {
+        std::string error = "socket: " + error_text(errno);
+        release_host(request->host);
+        return finish(std::move(request), std::move(error));
+      }
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      ++counters.syscalls;
+      ++counters.connections;
+
+      index = allocate();
+      Connection& connection = connections[index];
+      connection.fd = fd;
+      connection.host = request->host;
+      connection.reused = false;
+      connection.address = found;
+      std::uint16_t port = htons(static_cast<std::uint16_t>(std::atoi(request->target.port.c_str())));
+      if (found.ss_family == AF_INET6) {
+        reinterpret_cast<sockaddr_in6&>(connection.address).sin6_port = port;
+        connection.addressLength = sizeof(sockaddr_in6);
+      } else {
+        reinterpret_cast<sockaddr_in&>(connection.address).sin_port = port;
+        connection.addressLength = sizeof(sockaddr_in);
+      }
+    }
+
+    Connection& connection = connections[index];
+    connection.message = "GET " + request->target.path + " HTTP/1.1\r\nHost: " + request->target.authority + "\r\n";
+    for (auto& header : request->request.headers) {
+      connection.message += header.first + ": " + header.second + "\r\n";
+    }
+    connection.message += "Connection: keep-alive\r\n\r\n";
+    connection.wire.clear();
+    connection.sent = 0;
+    connection.received = 0;
+    connection.progressed = 0;
+    connection.parser.reset();
+    connection.result = HttpResult();
+    connection.result.uri = request->request.uri;
+    connection.firstByteBy = request->firstByteBy;
+    connection.doneBy = request->doneBy;
+    nextDeadline = std::min(nextDeadline, std::min(connection.firstByteBy, connection.doneBy));
+    connection.request = std::move(request);
+    connection.buffer = buffer();
+
+    if (connection.reused) {
+      try {
+        begin_request(index);
+      } catch (const std::exception& e) {
+        fail(index, e.what(), false);
+      }
+    } else {
+      connection.phase = Connection::connecting;
+      connection.op = Connection::connect_op;
+      io->connect(connection.fd, reinterpret_cast<const sockaddr*>(&connection.address), connection.addressLength, token(index, connection.generation));
+      connection.busy = true;
+    }
+  }
+
+  void send_wire(size_t index)
+  {
+    Connection& connection = connections[index];
+    connection.op = Connection::send_op;
+    io->send(connection.fd, connection.wire.data() + connection.sent, connection.wire.size() - connection.sent, token(index, connection.generation));
+    connection.busy = true;
+  }
+
+  void receive(size_t index)
+  {
+    Connection& connection = connections[index];
+    connection.op = Connection::recv_op;
+    io->recv(connection.fd, connection.buffer.get(), limits.buffer_size, token(index, connection.generation));
+    connection.busy = true;
+  }
+
+  // sends the request. over tls it is encrypted behind whatever the
+  // handshake left to send, so the client's Finished and the request
+  // go out in one send.
+  void begin_request(size_t index)
+  {
+    Connection& connection = connections[index];
+    if (connection.tls) {
+      connection.tls->write(connection.message.data(), connection.message.size());
+      connection.tls->take_output(connection.wire);
+    } else {
+      connection.wire.swap(connection.message);
+    }
+    connection.phase = Connection::sending;
+    send_wire(index);
+  }
+
+  // continues the tls handshake with what has been received so far
+  void handshake(size_t index)
+  {
+    Connection& connection = connections[index];
+    connection.wire.clear();
+    connection.sent = 0;
+    bool done = connection.tls->handshake();
+    connection.tls->take_output(connection.wire);
+    if (done) {
+      return begin_request(index);
+    }
+    connection.phase = Connection::handshaking;
+    if (!connection.wire.empty()) {
+      send_wire(index);
+    } else {
+      receive(index);
+    }
+  }
+
+  // feeds the response bytes received into the parser, through tls for
+  // https. ended is set when the server closed the tls session.
+  ResponseParser::State deliver(Connection& connection, int size, bool& ended)
+  {
+    ended = false;
+    if (!connection.tls) {
+      return connection.parser.feed(connection.buffer.get(), size, connection.result, limits.max_body);
+    }
+    connection.tls->received(connection.buffer.get(), size);
+    ResponseParser::State state = connection.parser.current();
+    for (;;) {
+      int read = connection.tls->read(plain.get(), limits.buffer_size);
+      if (read == 0) {
+        return state;
+      }
+      if (read < 0) {
+        ended = true;
+        return connection.parser.closed();
+      }
+      state = connection.parser.feed(plain.get(), read, connection.result, limits.max_body);
+      if (state == ResponseParser::complete || state == ResponseParser::invalid) {
+        return state;
+      }
+    }
+  }
+
+  void on_completion(size_t index, int result)
+  {
+    Connection& connection = connections[index];
+    if (connection.orphaned) {
+      // the operation outstanding when the connection was closed
+      connection.orphaned = false;
+      return release(index);
+    }
+    connection.busy = false;
+    switch (connection.phase) {
+    case Connection::idle:
+      break;
+    case Connection::connecting:
+      if (result < 0) {
+        // refused or unreachable, the host's next address is tried
+        // within the same deadlines
+        Request& request = *connection.request;
+        bool next = request.address + 1 < request.resolution.addresses.size();
+        if (next) {
+          ++request.address;
+        }
+        return fail(index, "connect: " + error_text(-result), next);
+      }
+      if (connection.request->target.secure) {
+        connection.tls.reset(new TlsSession(tls, connection.request->target.host, connection.host));
+        return handshake(index);
+      }
+      begin_request(index);
+      break;
+    case Connection::handshaking:
+      if (result < 0) {
+        return fail(index, (connection.op == Connection::send_op ? "send: " : "recv: ") + error_text(-result), false);
+      }
+      if (connection.op == Connection::send_op) {
+        counters.bytes_sent += result;
+        connection.sent += result;
+        if (connection.sent < connection.wire.size()) {
+          send_wire(index);
+          break;
+        }
+      } else {
+        if (result == 0) {
+          return fail(index, "connection closed during the tls handshake", false);
+        }
+        counters.bytes_received += result;
+        connection.tls->received(connection.buffer.get(), result);
+      }
+      handshake(index);
+      break;
+    case Connection::sending:
+      if (result < 0) {
+        return fail(index, "send: " + error_text(-result), connection.reused);
+      }
+      counters.bytes_sent += result;
+      connection.sent += result;
+      if (connection.sent < connection.wire.size()) {
+        send_wire(index);
+        break;
+      }
+      connection.phase = Connection::receiving;
+      receive(index);
+      break;
+    case Connection::receiving: {
+      if (result < 0) {
+        return fail(index, "recv: " + error_text(-result), connection.reused && connection.received == 0);
+      }
+      ResponseParser::State state;
+      bool ended = result == 0;
+      if (result == 0) {
+        // a keep-alive connection the server closed while it was idle
+        if (connection.received == 0) {
+          return fail(index, "connection closed before the response", connection.reused);
+        }
+        state = connection.parser.closed();
+      } else {
+        counters.bytes_received += result;
+        connection.received += result;
+        state = deliver(connection, result, ended);
+      }
+      if (state == ResponseParser::invalid) {
+        return fail(index, connection.parser.failure(), false);
+      }
+      bool complete = state == ResponseParser::complete;
+      auto& progress = connection.request->request.progress;
+      if (progress && connection.result.body.size() > connection.progressed) {
+        size_t from = connection.progressed;
+        connection.progressed = connection.result.body.size();
+        if (!progress(connection.result, from)) {
+          // the rest of the response is not wanted, nor the connection
+          // while the rest is still to come
+          connection.result.truncated = true;
+          return succeed(index, complete && !ended && connection.parser.keep_alive());
+        }
+      }
+      if (!complete) {
+        receive(index);
+        break;
+      }
+      succeed(index, !ended && connection.parser.keep_alive());
+      break;
+    }
+    }
+  }
+
+  // fails a request whose deadline passed while its host was looked up
+  void lookup_expired(std::unique_ptr<Request> request)
+  {
+    HttpResult result;
+    result.timed_out = true;
+    std::string error = "resolve " + request->target.host + ": no answer before the deadline";
+    release_host(request->host);
+    finish(std::move(request), std::move(error), std::move(result));
+  }
+
+  // fails the requests past a deadline. the connections are only
+  // scanned once the earliest deadline seen by the last scan is due.
+  void expire(clock::time_point now)
+  {
+    for (auto cursor = resolving.begin(); cursor != resolving.end() && cursor->first <= now;) {
+      std::unique_ptr<Request> request = cursor->second->take();
+      if (!request) {
+        // answered, and waiting in the inbox, which drops the entry
+        ++cursor;
+        continue;
+      }
+      cursor = resolving.erase(cursor);
+      lookup_expired(std::move(request));
+    }
+    if (now < nextDeadline) {
+      return;
+    }
+    nextDeadline = clock::time_point::max();
+    for (size_t index = 0; index < connections.size(); ++index) {
+      Connection& connection = connections[index];
+      if (!connection.request || connection.orphaned) {
+        continue;
+      }
+      if (now >= connection.doneBy || (connection.received == 0 && now >= connection.firstByteBy)) {
+        connection.result.timed_out = true;
+        fail(index, connection.received == 0 ? "no response before the first byte deadline" : "response not complete before the deadline", false);
+        continue;
+      }
+      nextDeadline = std::min(nextDeadline, connection.received ? connection.doneBy : std::min(connection.firstByteBy, connection.doneBy));
+    }
+  }
+
+  // closes the connections parked for longer than the idle timeout, which
+  // the server has likely closed its end of by now. nothing is
+  // outstanding on a parked connection, so its hangup would otherwise go
+  // unnoticed until it was reused.
+  void sweep(clock::time_point now)
+  {
+    while (!parkedOrder.empty()) {
+      const Parked& oldest = parkedOrder.front();
+      Connection& connection = connections[oldest.index];
+      bool parked = connection.generation == oldest.generation && connection.fd >= 0
+        && connection.phase == Connection::idle && !connection.request && connection.idleSince == oldest.since;
+      if (parked && now - oldest.since < limits.idle_timeout) {
+        break;
+      }
+      size_t index = oldest.index;
+      parkedOrder.pop_front();
+      if (!parked) {
+        continue;
+      }
+      auto found = idle.find(connection.host);
+      if (found != idle.end()) {
+        auto& indexes = found->second;
+        indexes.erase(std::remove(indexes.begin(), indexes.end(), index), indexes.end());
+        if (indexes.empty()) {
+          idle.erase(found);
+        }
+      }
+      close(index);
+    }
+  }
+
+  void release_host(const std::string& host)
+  {
+    --inFlight;
+    auto found = hostInFlight.find(host);
+    if (found != hostInFlight.end() && --found->second == 0) {
+      hostInFlight.erase(found);
+    }
+    // the host's longest held request goes first
+    auto held = blocked.find(host);
+    if (held != blocked.end()) {
+      ready.push_front(std::move(held->second.front()));
+      held->second.pop_front();
+      if (held->second.empty()) {
+        blocked.erase(held);
+      }
+    }
+  }
+
+  void finish(std::unique_ptr<Request> request, std::string error, HttpResult result = HttpResult())
+  {
+    result.uri = request->request.uri;
+    if (!error.empty()) {
+      result.error = std::move(error);
+      ++counters.failed;
+    } else {
+      ++counters.completed;
+    }
+    request->completion(std::move(result));
+  }
+
+  void succeed(size_t index, bool keep)
+  {
+    Connection& connection = connections[index];
+    std::unique_ptr<Request> request = std::move(connection.request);
+    HttpResult result = std::move(connection.result);
+    buffers.push_back(std::move(connection.buffer));
+    release_host(request->host);
+
+    auto found = idle.find(connection.host);
+    size_t parked = found == idle.end() ? 0 : found->second.size();
+    if (keep && parked < limits.max_idle_per_host) {
+      connection.phase = Connection::idle;
+      connection.idleSince = clock::now();
+      idle[connection.host].push_back(index);
+      Parked entry = { connection.idleSince, index, connection.generation };
+      parkedOrder.push_back(entry);
+    } else {
+      close(index);
+    }
+    finish(std::move(request), std::string(), std::move(result));
+  }
+
+  // retry is set when a reused connection failed before any response,
+  // the server closed it while idle, or connecting to an address of the
+  // host failed, so the request starts over.
+  void fail(size_t index, std::string error, bool retry)
+  {
+    Connection& connection = connections[index];
+    std::unique_ptr<Request> request = std::move(connection.request);
+    HttpResult result = std::move(connection.result);
+    close(index);
+    if (retry) {
+      // still counted in flight against its host
+      return start(std::move(request), clock::now());
+    }
+    release_host(request->host);
+    finish(std::move(request), std::move(error), std::move(result));
+  }
+
+  void close(size_t index)
+  {
+    Connection& connection = connections[index];
+    bool outstanding = io->abandon(connection.fd, connection.busy);
+    ::close(connection.fd);
+    ++counters.syscalls;
+    connection.fd = -1;
+    connection.phase = Connection::idle;
+    if (outstanding) {
+      // the buffer and request bytes stay with the connection until
+      // the kernel is done with them
+      connection.orphaned = true;
+    } else {
+      release(index);
+    }
+  }
+
+  void release(size_t index)
+  {
+    Connection& connection = connections[index];
+    if (connection.buffer) {
+      buffers.push_back(std::move(connection.buffer));
+    }
+    ++connection.generation;
+    connection.busy = false;
+    connection.request.reset();
+    connection.host.clear();
+    connection.message.clear();
+    connection.wire.clear();
+    connection.tls.reset();
+    unused.push_back(index);
+  }
+};
+
+HttpReactor::HttpReactor(HttpReactorLimits limits, Backend backend, std::shared_ptr<ResolverCache> resolver, std::shared_ptr<TlsContext> tls)
+  : loop(new Loop(limits, backend, std::move(resolver), std::move(tls)))
+{
+}
+
+HttpReactor::~HttpReactor()
+{
+}
+
+void HttpReactor::get(HttpRequest request, Completion completion)
+{
+  std::unique_ptr<Loop::Request> work(new Loop::Request());
+  std::string error;
+  if (!parse_target(request.uri, work->target, error)) {
+    HttpResult result;
+    result.uri = request.uri;
+    result.error = std::move(error);
+    ++loop->counters.requests;
+    ++loop->counters.failed;
+    completion(std::move(result));
+    return;
+  }
+  work->host = host_key(request.uri);
+  work->notBefore = std::chrono::steady_clock::now() + request.delay;
+  work->resolved = false;
+  work->address = 0;
+  work->request = std::move(request);
+  work->completion = std::move(completion);
+  if (!loop->inbox->post(loop->inbox->submitted, work)) {
+    Loop::cancel(std::move(work));
+  }
+}
+
+const char* HttpReactor::backend() const
+{
+  return loop->io->name();
+}
+
+const ReactorCounters& HttpReactor::counters() const
+{
+  return loop->counters;
+}
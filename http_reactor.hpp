@@ -0,0 +1,163 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___HTTP_REACTOR_INC__
+#define ___HTTP_REACTOR_INC__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+
+class ResolverCache;
+class TlsContext;
+
+struct HttpReactorLimits
+{
+  HttpReactorLimits()
+    : max_in_flight(1024)
+    , max_per_host(4)
+    , max_idle_per_host(4)
+    , idle_timeout(std::chrono::seconds(30))
+    , buffer_size(16 * 1024)
+    , max_body(64 * 1024 * 1024)
+  {}
+  // requests outstanding at once, in total and against one host:port
+  size_t max_in_flight;
+  size_t max_per_host;
+  // keep-alive connections kept open per host:port
+  size_t max_idle_per_host;
+  // parked keep-alive connections are closed once idle this long
+  std::chrono::steady_clock::duration idle_timeout;
+  // size of the pooled receive buffers
+  size_t buffer_size;
+  // largest body accepted, on the wire
+  size_t max_body;
+};
+
+struct HttpResult;
+
+struct HttpRequest
+{
+  HttpRequest()
+    : delay(std::chrono::steady_clock::duration::zero())
+    , first_byte(std::chrono::seconds(10))
+    , total(std::chrono::seconds(30))
+  {}
+  std::string uri;
+  std::vector<std::pair<std::string, std::string>> headers;
+  // how long to hold the request before starting it, e.g. a retry backoff
+  std::chrono::steady_clock::duration delay;
+  // until the status line arrives, including looking up the host and
+  // connecting
+  std::chrono::steady_clock::duration first_byte;
+  // until the body is complete
+  std::chrono::steady_clock::duration total;
+  // when set, called on the reactor thread as the body arrives with the
+  // result so far and the offset of the body bytes new since the last
+  // call, the last time once the body is complete. returning false ends
+  // the request there, the connection is closed unless the body was
+  // complete, and the result completes with truncated set.
+  std::function<bool(const HttpResult& result, size_t from)> progress;
+};
+
+struct HttpResult
+{
+  HttpResult() : status(0), timed_out(false), truncated(false) {}
+  std::string uri;
+  std::uint16_t status;
+  std::string message;
+  std::vector<std::pair<std::string, std::string>> headers;
+  std::string body;
+  // empty when the request succeeded
+  std::string error;
+  bool timed_out;
+  // the body was cut short by HttpRequest::progress
+  bool truncated;
+
+  // the value of the last header called name, compared ignoring case
+  std::string header(const std::string& name) const;
+};
+
+struct ReactorCounters
+{
+  ReactorCounters()
+    : requests(0), completed(0), failed(0), syscalls(0), submissions(0)
+    , connections(0), reused(0), bytes_sent(0), bytes_received(0)
+  {}
+  std::atomic<size_t> requests;
+  std::atomic<size_t> completed;
+  std::atomic<size_t> failed;
+  // every system call made by the reactor and its backend
+  std::atomic<size_t> syscalls;
+  // operations handed to the backend, several may share one system call
+  std::atomic<size_t> submissions;
+  std::atomic<size_t> connections;
+  std::atomic<size_t> reused;
+  std::atomic<size_t> bytes_sent;
+  std::atomic<size_t> bytes_received;
+};
+
+// an asynchronous HTTP/1.1 client for http and https uris. one thread drives
+// every connection through an io backend, io_uring where the kernel
+// supports it and epoll otherwise, so thousands of requests can be in
+// flight without a thread each. keep-alive connections are reused and
+// responses are received into pooled buffers. host names are resolved
+// asynchronously, so a slow lookup holds up only its own requests.
+// https connections resume the TLS session last issued by the host.
+class HttpReactor
+{
+public:
+  enum Backend { automatic, epoll, io_uring };
+
+  typedef std::function<void(HttpResult&&)> Completion;
+
+  // host names are looked up through resolver, or a cache of its own,
+  // and https connections are made in tls, or a context of its own
+  HttpReactor(HttpReactorLimits limits, Backend backend = automatic,
+      std::shared_ptr<ResolverCache> resolver = std::shared_ptr<ResolverCache>(),
+      std::shared_ptr<TlsContext> tls = std::shared_ptr<TlsContext>());
+
+  // fails the requests that are still pending
+  ~HttpReactor();
+
+  // thread-safe. completion is called on the reactor thread.
+  void get(HttpRequest request, Completion completion);
+
+  // the backend in use, "io_uring" or "epoll"
+  const char* backend() const;
+
+  const ReactorCounters& counters() const;
+
+private:
+  HttpReactor(const HttpReactor&);
+  HttpReactor& operator=(const HttpReactor&);
+
+  struct Loop;
+  std::unique_ptr<Loop> loop;
+};
+
+#endif  // ___HTTP_REACTOR_INC__
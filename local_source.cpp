@@ -0,0 +1,106 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "local_source.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <functional>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+bool is_local(const std::string& uri)
+{
+  return uri == "-" || uri.compare(0, 7, "file://") == 0;
+}
+
+std::string local_path(const std::string& uri)
+{
+  if (uri == "-") {
+    return uri;
+  }
+  // file:///path, or file://localhost/path
+  std::string path = uri.substr(7);
+  if (path.compare(0, 9, "localhost") == 0) {
+    path.erase(0, 9);
+  }
+  return path;
+}
+
+LocalDocument::LocalDocument(const std::string& uri, LocalCounters* counters)
+{
+  std::string path = local_path(uri);
+  if (path != "-") {
+    mapped.reset(new rapidxml::mapped_file<>(path.c_str()));
+  } else if (rapidxml::mapped_file<>::mappable(STDIN_FILENO)) {
+    mapped.reset(new rapidxml::mapped_file<>(STDIN_FILENO));
+  } else {
+    read.reset(new rapidxml::file<>(std::cin));
+  }
+  if (counters && mapped) {
+    ++counters->mapped;
+    counters->mapped_bytes += size();
+  } else if (counters) {
+    ++counters->read;
+    counters->read_bytes += size();
+  }
+}
+
+char* LocalDocument::data()
+{
+  return mapped ? mapped->data() : read->data();
+}
+
+size_t LocalDocument::size() const
+{
+  return (mapped ? mapped->size() : read->size()) - 1;
+}
+
+bool LocalDocument::truncated() const
+{
+  return mapped && mapped->truncated();
+}
+
+bool LocalSources::changed(const std::string& uri, size_t& digest)
+{
+  std::string path = local_path(uri);
+  Version version = {0, 0};
+  if (path != "-") {
+    struct stat status;
+    if (::stat(path.c_str(), &status) != 0) {
+      throw std::runtime_error("cannot stat " + path + ": " + std::strerror(errno));
+    }
+    version.size = status.st_size;
+    version.modified = static_cast<long long>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+  }
+  digest = std::hash<long long>()(version.size) * 31 + std::hash<long long>()(version.modified);
+  std::unique_lock<std::mutex> guard(lock);
+  auto found = versions.find(uri);
+  if (found != versions.end() && found->second.size == version.size && found->second.modified == version.modified) {
+    return false;
+  }
+  versions[uri] = version;
+  return true;
+}
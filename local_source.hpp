@@ -0,0 +1,100 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#pragma once
+#ifndef ___LOCAL_SOURCE_INC__
+#define ___LOCAL_SOURCE_INC__
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "rapidxml/rapidxml_utils.hpp"
+
+// true for "file://" uris and for "-", the document on stdin
+bool is_local(const std::string& uri);
+
+// the path of a file:// uri, or "-"
+std::string local_path(const std::string& uri);
+
+struct LocalCounters
+{
+  LocalCounters() : mapped(0), mapped_bytes(0), read(0), read_bytes(0) {}
+  // documents mapped from files, and read from a pipe
+  std::atomic<size_t> mapped;
+  std::atomic<size_t> mapped_bytes;
+  std::atomic<size_t> read;
+  std::atomic<size_t> read_bytes;
+};
+
+// a local document in memory, writable and followed by a 0 so that it
+// can be parsed in situ. files are mapped copy-on-write, and so is
+// stdin when it is redirected from a file. a pipe has to be read. a file
+// truncated while mapped does not raise SIGBUS, see truncated().
+class LocalDocument
+{
+public:
+  explicit LocalDocument(const std::string& uri, LocalCounters* counters = nullptr);
+
+  char* data();
+  // without the terminating 0
+  size_t size() const;
+
+  // true when the file shrank while it was mapped. the pages it lost
+  // read as zeros, so the text is cut short.
+  bool truncated() const;
+
+private:
+  LocalDocument(const LocalDocument&);
+  LocalDocument& operator=(const LocalDocument&);
+
+  std::unique_ptr<rapidxml::mapped_file<>> mapped;
+  std::unique_ptr<rapidxml::file<>> read;
+};
+
+// the local documents that are polled. a file is due again once its
+// size or modification time has changed, stdin only ever once.
+class LocalSources
+{
+public:
+  // returns true when uri has changed since it was last polled, with
+  // digest set from its size and modification time. throws
+  // std::runtime_error when it cannot be examined.
+  bool changed(const std::string& uri, size_t& digest);
+
+  LocalCounters& counters() { return documents; }
+
+private:
+  struct Version
+  {
+    long long size;
+    long long modified;
+  };
+
+  std::mutex lock;
+  std::map<std::string, Version> versions;
+  LocalCounters documents;
+};
+
+#endif  // ___LOCAL_SOURCE_INC__
@@ -21,12 +21,47 @@
 
 #include "rss.hpp"
 #include "atom.hpp"
+#include "fetch_queue.hpp"
+#include "connection_pool.hpp"
+#include "validator_cache.hpp"
+#include "content_decoder.hpp"
+#include "poll_schedule.hpp"
+#include "fetch_deadlines.hpp"
+#include "feed_error.hpp"
+#include "http_reactor.hpp"
+#include "resolver_cache.hpp"
+#include "tls_session.hpp"
+#include "redirect_cache.hpp"
+#include "token_bucket.hpp"
+#include "memory_budget.hpp"
+#include "entry_scanner.hpp"
+#include "local_source.hpp"
+#include "backfill.hpp"
+#include "uri_table.hpp"
+#include "feed_list.hpp"
+#include "feed_body.hpp"
+#include "document_pool.hpp"
+#include "xml_arena.hpp"
+#include "feed_stream.hpp"
 #include <network/http/client.hpp>
 #include <boost/foreach.hpp>
+#include <boost/program_options.hpp>
 #include <iostream>
 #include <fstream>
 #include <tuple>
 #include <regex>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <csignal>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <map>
+#include <unordered_set>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
 #include "rapidxml/rapidxml.hpp"
 #include "cpprx/rx.hpp"
 #include "cpplinq/linq.hpp"
@@ -40,6 +75,8 @@ struct Item
 {
   struct Source 
   {
+    // "atom" or "rss"
+    std::string format;
     std::string uri;
     std::string id;
     std::string title;
@@ -63,6 +100,7 @@ struct Item
 Item make_item(const http::client::response& r, const atom::feed& f, const atom::entry& e)
 {
   Item result;
+  result.source.format = "atom";
   r.get_source(result.source.uri);
   result.source.id = f.id();
   result.source.title = f.title();
@@ -83,6 +121,7 @@ Item make_item(const http::client::response& r, const atom::feed& f, const atom:
 Item make_item(const http::client::response& r, const rss::channel& c, const rss::item& i)
 {
   Item result;
+  result.source.format = "rss";
   r.get_source(result.source.uri);
   //result.source.id = ;
   result.source.title = c.title();
@@ -90,7 +129,7 @@ Item make_item(const http::client::response& r, const rss::channel& c, const rss
   //result.source.updated = c.updated();
   result.source.authorName = i.author();
   //result.source.authorEmail = c.author().email();
-  //result.data.id = ;
+  result.data.id = !i.guid().empty() ? i.guid() : i.link();
   result.data.author = i.author();
   result.data.title = i.title();
   //result.data.published = i.published();
@@ -100,12 +139,103 @@ Item make_item(const http::client::response& r, const rss::channel& c, const rss
   return result;
 }
 
-typedef std::shared_ptr<rxcpp::Observable<http::client::response>> HttpResponses;
+// the same fields as the make_item of the format that f is
+Item make_item(const http::client::response& r, const FeedStream& f, const FeedStream::Entry& e)
+{
+  auto& source = f.source();
+  Item result;
+  r.get_source(result.source.uri);
+  if (f.atom()) {
+    result.source.format = "atom";
+    result.source.id = source.id;
+    result.source.title = source.title;
+    result.source.subtitle = source.subtitle;
+    result.source.updated = source.updated;
+    result.source.authorName = source.author_name;
+    result.source.authorEmail = source.author_email;
+    result.data.id = e.id;
+    result.data.title = e.title;
+    result.data.published = e.published;
+    result.data.updated = e.updated;
+    result.data.summary = e.summary;
+    result.data.content = e.content;
+  } else {
+    result.source.format = "rss";
+    result.source.title = source.title;
+    result.source.subtitle = source.link;
+    result.source.authorName = e.author;
+    result.data.id = !e.id.empty() ? e.id : e.link;
+    result.data.author = e.author;
+    result.data.title = e.title;
+    result.data.content = e.content;
+  }
+  return result;
+}
+
+std::string source_of(const http::client::response& response)
+{
+    std::string uri;
+    response.get_source(uri);
+    return uri;
+}
+
+// a copy of the body of response, counted in body_counters(). the
+// client only hands a body out by value.
+std::string copy_body(const http::client::response& response)
+{
+    std::string text = body(response);
+    count_body_copy(text.size());
+    return text;
+}
+
+// when set, the stages report the failure of a feed here and carry on
+// with the next one instead of calling OnError and ending the stream.
+struct ErrorChannel
+{
+    std::shared_ptr<rxcpp::Observer<FeedError>> observer;
+    std::shared_ptr<FailureCounters> failures;
+    // serializes calls to observer from the stages
+    std::shared_ptr<std::mutex> emit;
+
+    explicit operator bool() const { return !!observer; }
+
+    void report(
+        const std::string& uri,
+        const char* stage,
+        const std::exception_ptr& error,
+        std::chrono::steady_clock::time_point start) const
+    {
+        FeedError record;
+        record.uri = uri;
+        record.stage = stage;
+        record.reason = describe(error);
+        record.duration = std::chrono::steady_clock::now() - start;
+        failures->record(record.stage);
+        std::unique_lock<std::mutex> guard(*emit);
+        observer->OnNext(std::move(record));
+    }
+};
+
+// a response and its body. the body is moved out of the response, so
+// that passing the response along the pipeline does not copy it. it is
+// null for a local uri, XmlParse maps the document itself.
+typedef std::tuple<http::client::response, std::shared_ptr<FeedBody>> FetchedFeed;
+
+// moves text, the body of response, into a FeedBody and empties the
+// body of response
+FetchedFeed fetched_feed(http::client::response response, std::string&& text)
+{
+    response << network::body(std::string());
+    return FetchedFeed(std::move(response), std::make_shared<FeedBody>(std::move(text)));
+}
+
+typedef std::shared_ptr<rxcpp::Observable<FetchedFeed>> HttpResponses;
 HttpResponses HttpGet(
-    const std::shared_ptr<rxcpp::Observable<std::string>>& sourceUris)
+    const std::shared_ptr<rxcpp::Observable<std::string>>& sourceUris,
+    ErrorChannel errors = ErrorChannel())
 {
-    return rxcpp::CreateObservable<http::client::response>(
-        [=](std::shared_ptr<rxcpp::Observer<http::client::response>> observer) 
+    return rxcpp::CreateObservable<FetchedFeed>(
+        [=](std::shared_ptr<rxcpp::Observer<FetchedFeed>> observer) 
         -> rxcpp::Disposable
         {
             struct State 
@@ -125,14 +255,19 @@ HttpResponses HttpGet(
             // on next
                 [=](const std::string& uri)
                 {
+                    auto start = std::chrono::steady_clock::now();
                     try {
                         http::client::request request(uri);
                         request << network::header("Connection", "close");
                         http::client::response response = state->client.get(request);
+                        std::string text = copy_body(response);
                         if (!state->cancel)
-                            observer->OnNext(std::move(response));
+                            observer->OnNext(fetched_feed(std::move(response), std::move(text)));
                     } catch (...) {
-                        observer->OnError(std::current_exception());
+                        if (errors)
+                            errors.report(uri, "http_get", std::current_exception(), start);
+                        else
+                            observer->OnError(std::current_exception());
                     }
                 },
             // on completed
@@ -153,14 +288,971 @@ HttpResponses HttpGet(
 }
 
 
+// replaces text, a gzip or deflate body of response, with the decoded
+// body and removes the Content-Encoding of response
+void decode_body(
+    const std::string& uri,
+    http::client::response& response,
+    std::string& text,
+    size_t max_decoded,
+    TransferStats& transfers)
+{
+    std::string contentEncoding;
+    response.get_headers(
+      "Content-Encoding",
+      [&](std::string const& name, std::string const& value){
+        contentEncoding = value;});
+    if (contentEncoding.empty() || contentEncoding == "identity") {
+        // the body as received, chunked responses have no Content-Length
+        transfers.record(uri, text.size(), text.size());
+        return;
+    }
+    if (!is_decodable(contentEncoding)) {
+        throw std::runtime_error("unsupported Content-Encoding: " + contentEncoding);
+    }
+
+    ContentDecoder decoder(contentEncoding, max_decoded);
+    decoder.write(text.data(), text.size());
+    text = std::move(decoder.finish());
+    response << network::remove_header("Content-Encoding");
+    // finish() hands out the decoder's buffer, it is empty now
+    transfers.record(uri, decoder.encoded_size(), text.size());
+}
+
+// the state shared by every fetch in HttpGetConcurrent
+struct FetchServices
+{
+    FetchDeadlines deadlines;
+    std::shared_ptr<ConnectionPool> connections;
+    std::shared_ptr<ValidatorCache> validators;
+    std::shared_ptr<TransferStats> transfers;
+    std::shared_ptr<PollSchedule> schedule;
+    std::shared_ptr<FetchCounters> fetches;
+    std::shared_ptr<LatencyHistory> latencies;
+    std::shared_ptr<DeadlineCounters> timeouts;
+    // used by HttpGetReactor in place of the connection pool
+    std::shared_ptr<HttpReactor> reactor;
+    std::shared_ptr<ResolverCache> resolver;
+    std::shared_ptr<RedirectCache> redirects;
+    // the bodies emitted are charged to it, and no fetch is started
+    // while it is exceeded
+    std::shared_ptr<MemoryBudget> budget;
+    // when set, HttpGetReactor stops receiving a feed at the first entry
+    // delivered by an earlier poll
+    std::shared_ptr<SeenEntries> seen;
+    // when set, HttpGetReactor extracts the entries of an xml body as it
+    // arrives and passes them here rather than emitting the body, for
+    // StreamEntries to emit along with its own
+    std::shared_ptr<rxcpp::Observer<Item>> entries;
+    // file:// uris and stdin, polled without http
+    std::shared_ptr<LocalSources> locals;
+};
+
+// returns uri with its host replaced by an address from resolver, so the
+// client does not look the host up again on every poll. authority is set
+// to the host and port for the Host header. https uris are returned as
+// they are, their certificate is checked against the host name. attempt
+// picks the address, so each retry or hedge of a fetch goes to the next
+// address of the host, past one that refuses or does not answer.
+std::string resolved_uri(
+    const std::string& uri,
+    ResolverCache& resolver,
+    std::string& authority,
+    size_t attempt)
+{
+    std::string key = host_key(uri);
+    std::string normal = normalize_uri(uri);
+    if (key.compare(0, 7, "http://") != 0)
+        return uri;
+    std::string::size_type path = normal.find('/', 7);
+    authority = normal.substr(7, path - 7);
+    if (authority.find('@') != std::string::npos)
+        return uri;
+
+    std::string::size_type colon = key.rfind(':');
+    std::string host = key.substr(7, colon - 7);
+    if (!host.empty() && host[0] == '[')
+        return uri;
+    Resolution resolution = resolver.resolve(host);
+    if (!resolution.error.empty())
+        throw std::runtime_error(resolution.error);
+    const sockaddr_storage& address = resolution.addresses[attempt % resolution.addresses.size()];
+    std::string numeric = numeric_host(address);
+    if (address.ss_family == AF_INET6)
+        numeric = "[" + numeric + "]";
+    return "http://" + numeric + key.substr(colon) + normal.substr(path);
+}
+
+// reports Cache-Control: max-age as the least poll interval for uri
+void hint_cache_control(
+    const std::string& uri,
+    const http::client::response& response,
+    PollSchedule& schedule)
+{
+    std::string cacheControl;
+    response.get_headers(
+      "Cache-Control",
+      [&](std::string const& name, std::string const& value){
+        cacheControl = value;});
+    schedule.hint(uri, PollSchedule::cache_control, cache_control_max_age(cacheControl));
+}
+
+// the result of one attempt at fetching a feed
+struct FetchAttempt
+{
+    FetchAttempt() : modified(false), digest(0), size(0) {}
+    // false for a 304, there is no body
+    bool modified;
+    size_t digest;
+    // of the decoded body
+    size_t size;
+    // without its body, which is moved into body
+    http::client::response response;
+    std::string body;
+    // the uri requested, after redirects, that the validators are kept for
+    std::string target;
+};
+
+// moves text, the decoded body of response to a request for target,
+// into a FeedBody. the validators of response are only stored once the
+// body has been parsed, so the next poll stays unconditional until then.
+std::shared_ptr<FeedBody> validated_body(
+    std::string&& text,
+    const http::client::response& response,
+    const std::string& target,
+    const std::shared_ptr<ValidatorCache>& validators)
+{
+    auto body = std::make_shared<FeedBody>(std::move(text));
+    if (status(response) == 200) {
+        body->when_parsed([=]{
+            validators->commit(target, response);});
+    }
+    return body;
+}
+
+// one attempt at fetching uri, run on its own thread by race_fetch.
+// returns once the whole body has arrived. the client cannot be given a
+// timeout, so an attempt at a server that stops answering holds its
+// thread and connection until the server closes it. a connection is
+// only waited for until deadline, and not at all while max_per_host
+// attempts are waiting already, so the attempts held by a hung host
+// stay bounded by max_per_host.
+FetchAttempt attempt_fetch(
+    const std::string& uri,
+    const FetchLimits& limits,
+    const FetchServices& services,
+    Race<FetchAttempt>::Entrant& entrant,
+    std::chrono::steady_clock::time_point deadline,
+    size_t retry)
+{
+    FetchAttempt result;
+    result.target = uri;
+    std::string authority;
+    std::string target = services.resolver ?
+        resolved_uri(uri, *services.resolver, authority, retry + entrant.index()) : uri;
+    http::client::request request(target);
+    if (target != uri)
+        request << network::header("Host", authority);
+    request << network::header("Accept-Encoding", accept_encoding);
+    services.validators->apply(uri, request);
+    auto lease = services.connections->acquire(uri, deadline);
+    if (!lease)
+        throw fetch_timeout("no connection to " + host_key(uri) + " became free");
+    try {
+        result.response = lease.client().get(request);
+        // waits for the status line and headers
+        status(result.response);
+        if (target != uri)
+            result.response << network::source(uri);
+        entrant.first_byte();
+        if (!services.validators->not_modified(uri, result.response)) {
+            // waits for the rest of the body
+            result.body = copy_body(result.response);
+            result.response << network::body(std::string());
+            decode_body(uri, result.response, result.body, limits.max_decoded, *services.transfers);
+            result.digest = std::hash<std::string>()(result.body);
+            result.size = result.body.size();
+            result.modified = true;
+        }
+    } catch (...) {
+        lease.discard();
+        throw;
+    }
+    if (entrant.abandoned()) {
+        // nobody is waiting for this connection to be reused promptly
+        lease.discard();
+    }
+    return result;
+}
+
+// runs attempt_fetch within the first byte and total deadlines. when
+// hedging, a second attempt is started once the first has taken longer
+// than the p95 latency of the feed and the first to finish wins.
+FetchAttempt race_fetch(
+    const std::string& uri,
+    size_t retry,
+    const FetchLimits& limits,
+    const FetchServices& services)
+{
+    typedef std::chrono::steady_clock clock;
+    auto& deadlines = services.deadlines;
+    auto race = std::make_shared<Race<FetchAttempt>>();
+
+    auto start = clock::now();
+    auto firstByte = start + deadlines.first_byte;
+    auto total = start + deadlines.total;
+    auto connected = std::min(firstByte, total);
+    auto run = [=](Race<FetchAttempt>::Entrant& entrant){
+        return attempt_fetch(uri, limits, services, entrant, connected, retry);};
+    auto hedgeAt = clock::time_point::max();
+    if (deadlines.hedge) {
+        auto p95 = services.latencies->percentile(uri, 0.95, deadlines.hedge_min_samples);
+        if (p95 != clock::duration::zero()) {
+            hedgeAt = start + p95;
+        }
+    }
+
+    race->launch(run);
+    for (;;) {
+        auto deadline = race->first_byte() ? total : std::min(firstByte, total);
+        auto outcome = race->wait_until(std::min(deadline, hedgeAt));
+        if (outcome == Race<FetchAttempt>::won) {
+            race->abandon();
+            services.latencies->record(uri, clock::now() - start);
+            if (race->winning_attempt() > 0) {
+                ++services.timeouts->hedge_wins;
+            }
+            return race->take();
+        }
+        if (outcome == Race<FetchAttempt>::failed) {
+            race->abandon();
+            std::rethrow_exception(race->failure());
+        }
+        auto now = clock::now();
+        if (now >= hedgeAt) {
+            hedgeAt = clock::time_point::max();
+            ++services.timeouts->hedges;
+            race->launch(run);
+        } else if (now >= deadline) {
+            race->abandon();
+            ++services.timeouts->timeouts;
+            throw fetch_timeout((race->first_byte() ? "timed out reading " : "timed out waiting for ") + uri);
+        }
+    }
+}
+
+// race_fetch, following redirects from uri. the redirects known to be
+// permanent are skipped and new ones are remembered, so the next poll
+// goes straight to where the feed is now.
+FetchAttempt redirected_fetch(
+    const std::string& uri,
+    size_t retry,
+    const FetchLimits& limits,
+    const FetchServices& services)
+{
+    std::string target = services.redirects->apply(uri);
+    for (size_t hops = 0;; ++hops) {
+        FetchAttempt attempt = race_fetch(target, retry, limits, services);
+        std::string location;
+        attempt.response.get_headers(
+          "Location",
+          [&](std::string const& name, std::string const& value){
+            location = value;});
+        std::string next = services.redirects->redirected(target, status(attempt.response), location);
+        if (next.empty() || hops == RedirectCache::max_hops) {
+            // downstream knows the feed by the uri it was pushed as
+            attempt.response << network::source(uri);
+            return attempt;
+        }
+        target = next;
+    }
+}
+
+// fetches uri into fetched, after retry earlier attempts. returns false
+// when the feed is unchanged and there is nothing to emit, or when the
+// attempt is to be retried, after backoff. redirects are followed.
+// timeouts, network errors and 429 or 5xx statuses are retried with
+// exponential backoff up to max_retries. the caller waits out the
+// backoff, so no thread is held while it passes.
+bool fetch_feed(
+    const std::string& uri,
+    size_t retry,
+    const FetchLimits& limits,
+    const FetchServices& services,
+    FetchAttempt& fetched,
+    std::chrono::steady_clock::duration& backoff)
+{
+    auto& deadlines = services.deadlines;
+    bool last = retry >= deadlines.max_retries;
+    backoff = std::chrono::steady_clock::duration::zero();
+    try {
+        FetchAttempt attempt = redirected_fetch(uri, retry, limits, services);
+        std::uint16_t code = status(attempt.response);
+        if (last || (code != 429 && code < 500)) {
+            hint_cache_control(uri, attempt.response, *services.schedule);
+            if (!attempt.modified) {
+                services.schedule->unchanged(uri);
+            } else if (code >= 400) {
+                services.schedule->failed(uri);
+            } else {
+                services.schedule->fetched(uri, attempt.digest);
+            }
+            fetched = std::move(attempt);
+            return fetched.modified;
+        }
+    } catch (const std::logic_error&) {
+        // a limit was exceeded or the response is not understood,
+        // trying again will not help
+        services.schedule->failed(uri);
+        throw;
+    } catch (...) {
+        if (last) {
+            services.schedule->failed(uri);
+            throw;
+        }
+    }
+    ++services.timeouts->retries;
+    backoff = deadlines.retry_backoff * (1 << std::min<size_t>(retry, 10));
+    return false;
+}
+
+// polls a local uri. returns false when it is unchanged. otherwise
+// response is set to a 200 with no body for XmlParse to map the
+// document into, rather than it being read and copied along the way.
+bool local_fetch(
+    const std::string& uri,
+    const FetchServices& services,
+    http::client::response& response)
+{
+    size_t digest = 0;
+    try {
+        if (!services.locals->changed(uri, digest)) {
+            services.schedule->unchanged(uri);
+            return false;
+        }
+    } catch (...) {
+        services.schedule->failed(uri);
+        throw;
+    }
+    services.schedule->fetched(uri, digest);
+    response << network::source(uri)
+             << network::status(200)
+             << network::header("Content-Type", "application/xml");
+    return true;
+}
+
+// like HttpGet, but the uris are fetched on a pool of workers so that
+// up to limits.max_in_flight requests (limits.max_per_host per host)
+// are outstanding at once. responses are emitted as they complete.
+// connections are kept alive in the pool and reused across rounds.
+// requests are conditional on the validators of the last response and
+// a "304 Not Modified" ends the poll here, nothing is emitted for it.
+// gzip and deflate bodies are decoded before the response is emitted,
+// so the body emitted is always the plain document. the outcome of each
+// fetch is reported to the poll schedule. a poll of a uri that is
+// already queued or being fetched is coalesced or skipped. a worker
+// holds off starting a fetch while services.budget is exceeded. local
+// uris are polled by local_fetch as they arrive.
+HttpResponses HttpGetConcurrent(
+    const std::shared_ptr<rxcpp::Observable<std::string>>& sourceUris,
+    FetchLimits limits,
+    FetchServices services,
+    ErrorChannel errors = ErrorChannel())
+{
+    return rxcpp::CreateObservable<FetchedFeed>(
+        [=](std::shared_ptr<rxcpp::Observer<FetchedFeed>> observer) 
+        -> rxcpp::Disposable
+        {
+            struct State 
+            {
+                State() : cancel(false) {}
+                std::atomic<bool> cancel;
+                // serializes calls to observer from the workers
+                std::mutex emit;
+                std::unique_ptr<FetchQueue> queue;
+            };
+            auto state = std::make_shared<State>();
+
+            state->queue.reset(new FetchQueue(
+                limits,
+            // fetch
+                [=](const std::string& uri, size_t retry)
+                -> FetchQueue::clock::duration
+                {
+                    auto backoff = FetchQueue::clock::duration::zero();
+                    if (services.budget && !services.budget->wait())
+                        return backoff;
+                    auto start = std::chrono::steady_clock::now();
+                    try {
+                        FetchAttempt fetched;
+                        if (!fetch_feed(uri, retry, limits, services, fetched, backoff))
+                            return backoff;
+                        std::unique_lock<std::mutex> guard(state->emit);
+                        if (state->cancel)
+                            return backoff;
+                        if (services.budget)
+                            services.budget->charge(MemoryBudget::fetched, fetched.size);
+                        auto body = validated_body(
+                            std::move(fetched.body), fetched.response, fetched.target, services.validators);
+                        observer->OnNext(FetchedFeed(std::move(fetched.response), std::move(body)));
+                    } catch (...) {
+                        if (errors) {
+                            errors.report(uri, "http_get_concurrent", std::current_exception(), start);
+                            return backoff;
+                        }
+                        std::unique_lock<std::mutex> guard(state->emit);
+                        if (!state->cancel)
+                            observer->OnError(std::current_exception());
+                        state->cancel = true;
+                        state->queue->cancel();
+                    }
+                    return backoff;
+                },
+            // drained
+                [=]
+                {
+                    std::unique_lock<std::mutex> guard(state->emit);
+                    if (!state->cancel)
+                        observer->OnCompleted();
+                },
+                services.fetches));
+
+            rxcpp::ComposableDisposable cd;
+
+            cd.Add(rxcpp::Disposable([=]{ 
+                state->cancel = true; 
+                state->queue->cancel();}));
+
+            cd.Add(rxcpp::Subscribe(
+                sourceUris,
+            // on next
+                [=](const std::string& uri)
+                {
+                    if (!is_local(uri)) {
+                        state->queue->push(uri);
+                        return;
+                    }
+                    auto start = std::chrono::steady_clock::now();
+                    try {
+                        http::client::response response;
+                        if (!local_fetch(uri, services, response))
+                            return;
+                        std::unique_lock<std::mutex> guard(state->emit);
+                        if (!state->cancel)
+                            observer->OnNext(FetchedFeed(std::move(response), nullptr));
+                    } catch (...) {
+                        if (errors) {
+                            errors.report(uri, "local_fetch", std::current_exception(), start);
+                            return;
+                        }
+                        std::unique_lock<std::mutex> guard(state->emit);
+                        if (!state->cancel)
+                            observer->OnError(std::current_exception());
+                        state->cancel = true;
+                        state->queue->cancel();
+                    }
+                },
+            // on completed
+                [=]
+                {
+                    state->queue->close();
+                },
+            // on error
+                [=](const std::exception_ptr& error)
+                {
+                    state->queue->cancel();
+                    std::unique_lock<std::mutex> guard(state->emit);
+                    if (!state->cancel)
+                        observer->OnError(error);
+                }));
+            return cd;
+        }
+    );
+}
+
+// builds the response the netlib client would have returned, but for
+// the body, which is left in result
+http::client::response make_response(const HttpResult& result)
+{
+    http::client::response response;
+    response << network::source(result.uri)
+             << network::status(result.status);
+    for (auto& header : result.headers)
+        response << network::header(header.first, header.second);
+    return response;
+}
+
+// the state of one subscription to HttpGetReactor
+struct ReactorFetches
+{
+    typedef TokenBucket::clock clock;
+
+    ReactorFetches(FetchLimits l, FetchServices s, ErrorChannel e)
+        : limits(l)
+        , services(s)
+        , errors(e)
+        , cancel(false)
+        , closed(false)
+        , outstanding(0)
+        , global(l.global_rate, l.global_burst, clock::now())
+    {}
+
+    FetchLimits limits;
+    FetchServices services;
+    ErrorChannel errors;
+    std::shared_ptr<rxcpp::Observer<FetchedFeed>> observer;
+    std::atomic<bool> cancel;
+
+    // guards the members below and serializes calls to observer
+    std::mutex lock;
+    bool closed;
+    size_t outstanding;
+    // normalized uris that are queued in the reactor or being fetched
+    std::unordered_set<std::string> fetching;
+    std::map<std::string, TokenBucket> hostBuckets;
+    TokenBucket global;
+
+    // takes a token for a request to host and returns how long the
+    // request must wait for it. must hold lock.
+    clock::duration reserve(const std::string& host)
+    {
+        auto now = clock::now();
+        auto found = hostBuckets.find(host);
+        if (found == hostBuckets.end()) {
+            found = hostBuckets.insert(std::make_pair(host, TokenBucket(
+                host_rate(limits, host), limits.host_burst, now))).first;
+        }
+        auto start = std::max(found->second.ready_at(now), global.ready_at(now));
+        found->second.take(now);
+        global.take(now);
+        return start - now;
+    }
+
+    // the fetch of uri is over, successful or not
+    void finished(const std::string& uri)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        fetching.erase(normalize_uri(uri));
+        if (--outstanding == 0 && closed && !cancel)
+            observer->OnCompleted();
+    }
+};
+
+// one request of a fetch through the reactor
+struct ReactorAttempt
+{
+    ReactorAttempt() : retry(0), hops(0), emitted(0) {}
+    // the feed, as it was pushed
+    std::string uri;
+    // what is requested, after redirects
+    std::string target;
+    size_t retry;
+    size_t hops;
+    // the entries an earlier attempt streamed before it failed, which
+    // are not emitted again
+    size_t emitted;
+};
+
+bool xml_content_type(const std::string& field);
+
+// the body of a 200 response read as it arrives. with seen it is
+// scanned for entries to stop at the first one that was delivered
+// before. a feed not known to list its newest entries first is scanned
+// whole instead, to check whether it does. with entries the entries of
+// an xml body are extracted and passed there as they are read, up to
+// where a scan stopped.
+struct StreamedFeed
+{
+    StreamedFeed()
+        : max_decoded(0)
+        , skip(0)
+        , started(false)
+        , scanning(false)
+        , stop(false)
+        , reached(false)
+        , unordered(false)
+        , written(0)
+    {}
+    std::string uri;
+    size_t max_decoded;
+    std::shared_ptr<SeenEntries> seen;
+    std::shared_ptr<rxcpp::Observer<Item>> entries;
+    // the entries to pass over, emitted by an earlier attempt
+    size_t skip;
+    bool started;
+    bool scanning;
+    // whether the scan stops at a seen entry
+    bool stop;
+    // a seen entry was scanned, and a new one after it
+    bool reached;
+    bool unordered;
+    std::unique_ptr<ContentDecoder> decoder;
+    EntryScanner scanner;
+    std::unique_ptr<FeedStream> stream;
+    // the decoded bytes written to stream, and why it failed
+    size_t written;
+    std::exception_ptr failed;
+    // the source of the items, the feed uri
+    http::client::response source;
+
+    // the decoded body so far
+    const std::string& text(const HttpResult& result) const
+    {
+        return decoder ? decoder->output() : result.body;
+    }
+
+    // HttpRequest::progress for the feed uri
+    bool progress(const HttpResult& result, size_t from)
+    {
+        if (!started) {
+            started = true;
+            std::string contentEncoding = result.header("Content-Encoding");
+            bool identity = contentEncoding.empty() || contentEncoding == "identity";
+            scanning = result.status == 200 && (identity || is_decodable(contentEncoding));
+            if (scanning && !identity)
+                decoder.reset(new ContentDecoder(contentEncoding, max_decoded));
+            if (seen)
+                stop = seen->ordered(uri);
+            if (scanning && entries && streamable(result.header("Content-Type"))) {
+                source << network::source(uri);
+                stream.reset(new FeedStream([this](const FeedStream& f, const FeedStream::Entry& e){
+                    if (f.entries() > skip)
+                        entries->OnNext(make_item(source, f, e));}));
+            }
+        }
+        if (!scanning)
+            return true;
+        if (decoder)
+            decoder->write(result.body.data() + from, result.body.size() - from);
+        const std::string& decoded = text(result);
+        bool more = true;
+        if (seen) {
+            more = scanner.scan(decoded, [&](const std::string& id){
+                if (!seen->seen(uri, id)) {
+                    unordered = unordered || reached;
+                    return true;
+                }
+                reached = true;
+                return !stop;});
+        }
+        if (stream && !failed) {
+            size_t end = scanner.stopped() ? scanner.stopped_at() : decoded.size();
+            try {
+                stream->write(decoded.data() + written, end - written);
+                written = end;
+            } catch (...) {
+                failed = std::current_exception();
+            }
+        }
+        return more;
+    }
+
+    // a body of any other type goes down the pipeline to be sorted by
+    // its content type as usual
+    static bool streamable(const std::string& contentType)
+    {
+        try {
+            return xml_content_type(contentType);
+        } catch (...) {
+            return false;
+        }
+    }
+};
+
+void reactor_fetched(
+    const std::shared_ptr<ReactorFetches>& state,
+    const ReactorAttempt& attempt,
+    std::chrono::steady_clock::time_point started,
+    const std::shared_ptr<StreamedFeed>& streamed,
+    HttpResult&& result);
+
+// hands attempt to the reactor, to start after delay
+void reactor_fetch(
+    const std::shared_ptr<ReactorFetches>& state,
+    const ReactorAttempt& attempt,
+    std::chrono::steady_clock::duration delay)
+{
+    auto& deadlines = state->services.deadlines;
+    HttpRequest request;
+    request.uri = attempt.target;
+    request.headers.push_back(std::make_pair("Accept-Encoding", accept_encoding));
+    state->services.validators->apply(attempt.target, request.headers);
+    request.delay = delay;
+    request.first_byte = deadlines.first_byte;
+    request.total = deadlines.total;
+    std::shared_ptr<StreamedFeed> streamed;
+    if (state->services.seen || state->services.entries) {
+        streamed = std::make_shared<StreamedFeed>();
+        streamed->uri = attempt.uri;
+        streamed->max_decoded = state->limits.max_decoded;
+        streamed->seen = state->services.seen;
+        streamed->entries = state->services.entries;
+        streamed->skip = attempt.emitted;
+        request.progress = [=](const HttpResult& result, size_t from){
+            return streamed->progress(result, from);};
+    }
+    auto started = std::chrono::steady_clock::now() + delay;
+    state->services.reactor->get(
+        std::move(request),
+        [=](HttpResult&& result){
+            reactor_fetched(state, attempt, started, streamed, std::move(result));});
+}
+
+// called on the reactor thread with the outcome of an attempt. the
+// outcome is handled as fetch_feed handles it. a body that was stopped
+// at a seen entry is emitted with only the entries before it, or not at
+// all when there are none. a body whose entries were passed on as it
+// arrived is not emitted, only the end of its document is checked.
+void reactor_fetched(
+    const std::shared_ptr<ReactorFetches>& state,
+    const ReactorAttempt& attempt,
+    std::chrono::steady_clock::time_point started,
+    const std::shared_ptr<StreamedFeed>& streamed,
+    HttpResult&& result)
+{
+    auto& services = state->services;
+    auto& deadlines = services.deadlines;
+    auto& uri = attempt.uri;
+    try {
+        if (state->cancel) {
+            state->finished(uri);
+            return;
+        }
+        if (result.timed_out)
+            ++services.timeouts->timeouts;
+        bool failed = !result.error.empty() || result.status == 429 || result.status >= 500;
+        if (failed && attempt.retry < deadlines.max_retries) {
+            ++services.timeouts->retries;
+            ReactorAttempt retry = attempt;
+            ++retry.retry;
+            if (streamed && streamed->stream)
+                retry.emitted = std::max(attempt.emitted, streamed->stream->entries());
+            reactor_fetch(state, retry, deadlines.retry_backoff * (1 << std::min<size_t>(attempt.retry, 10)));
+            return;
+        }
+        if (result.timed_out)
+            throw fetch_timeout(result.error + ", " + attempt.target);
+        if (!result.error.empty())
+            throw std::runtime_error(result.error + ", " + attempt.target);
+        services.latencies->record(attempt.target, std::chrono::steady_clock::now() - started);
+
+        std::string next = services.redirects->redirected(attempt.target, result.status, result.header("Location"));
+        if (!next.empty() && attempt.hops < RedirectCache::max_hops) {
+            ReactorAttempt redirect = attempt;
+            redirect.target = next;
+            ++redirect.hops;
+            reactor_fetch(state, redirect, std::chrono::steady_clock::duration::zero());
+            return;
+        }
+
+        bool truncated = result.truncated;
+        bool fresh = true;
+        if (truncated) {
+            size_t received = result.body.size();
+            fresh = streamed->scanner.entries() != 0;
+            services.seen->stopped(uri, !fresh, received, std::strtoul(result.header("Content-Length").c_str(), nullptr, 10));
+            std::string text = streamed->scanner.truncated(streamed->text(result));
+            services.transfers->record(attempt.target, received, text.size());
+            result.body = std::move(text);
+        } else if (streamed && streamed->reached) {
+            services.seen->checked(uri, !streamed->unordered);
+        }
+
+        // downstream knows the feed by the uri it was pushed as
+        result.uri = uri;
+        http::client::response response = make_response(result);
+        if (truncated)
+            response << network::remove_header("Content-Encoding");
+        std::uint16_t code = status(response);
+        hint_cache_control(uri, response, *services.schedule);
+        bool modified = !services.validators->not_modified(attempt.target, response);
+        if (!modified) {
+            services.schedule->unchanged(uri);
+        } else if (!fresh) {
+            // every entry up to the stop was delivered before, there is
+            // nothing to parse and the feed is as good as unchanged
+            services.validators->commit(attempt.target, response);
+            services.schedule->unchanged(uri);
+        } else {
+            bool streaming = streamed && streamed->stream;
+            if (streaming && !truncated) {
+                // decoded as it arrived, by the streamed feed's decoder
+                if (streamed->decoder)
+                    response << network::remove_header("Content-Encoding");
+                services.transfers->record(attempt.target, result.body.size(), streamed->text(result).size());
+            } else if (!truncated) {
+                decode_body(attempt.target, response, result.body, state->limits.max_decoded, *services.transfers);
+            }
+            if (code >= 400) {
+                services.schedule->failed(uri);
+            } else {
+                const std::string& text = streaming && !truncated ? streamed->text(result) : result.body;
+                services.schedule->fetched(uri, std::hash<std::string>()(text));
+            }
+            if (streaming) {
+                try {
+                    if (streamed->failed)
+                        std::rethrow_exception(streamed->failed);
+                    if (!truncated) {
+                        if (streamed->decoder)
+                            streamed->decoder->finish();
+                        streamed->stream->finish();
+                    }
+                    services.validators->commit(attempt.target, response);
+                    auto& source = streamed->stream->source();
+                    if (!streamed->stream->atom())
+                        services.schedule->hint(uri, PollSchedule::feed_ttl,
+                            feed_update_interval(source.ttl, source.update_period, source.update_frequency));
+                } catch (...) {
+                    if (!state->errors)
+                        throw;
+                    state->errors.report(uri, "stream_entries", std::current_exception(), started);
+                }
+            } else {
+                std::unique_lock<std::mutex> guard(state->lock);
+                if (!state->cancel) {
+                    if (services.budget)
+                        services.budget->charge(MemoryBudget::fetched, result.body.size());
+                    auto body = validated_body(
+                        std::move(result.body), response, attempt.target, services.validators);
+                    state->observer->OnNext(FetchedFeed(std::move(response), std::move(body)));
+                }
+            }
+        }
+    } catch (...) {
+        services.schedule->failed(uri);
+        if (state->errors) {
+            state->errors.report(uri, "http_get_reactor", std::current_exception(), started);
+        } else {
+            std::unique_lock<std::mutex> guard(state->lock);
+            if (!state->cancel)
+                state->observer->OnError(std::current_exception());
+            state->cancel = true;
+        }
+    }
+    state->finished(uri);
+}
+
+// like HttpGetConcurrent, but every request is driven by one reactor
+// thread (services.reactor) over io_uring or epoll, rather than each
+// taking a worker thread for its blocking calls. requests are
+// conditional, bodies are decoded, timeouts and 429/5xx statuses are
+// retried with backoff and the outcome is reported to the schedule as
+// in fetch_feed. the rate limits delay the start of a request, and so
+// does services.budget while it is exceeded. requests are not hedged.
+// https connections resume the sessions of earlier ones. local uris are
+// polled by local_fetch as they arrive.
+HttpResponses HttpGetReactor(
+    const std::shared_ptr<rxcpp::Observable<std::string>>& sourceUris,
+    FetchLimits limits,
+    FetchServices services,
+    ErrorChannel errors = ErrorChannel())
+{
+    return rxcpp::CreateObservable<FetchedFeed>(
+        [=](std::shared_ptr<rxcpp::Observer<FetchedFeed>> observer) 
+        -> rxcpp::Disposable
+        {
+            auto state = std::make_shared<ReactorFetches>(limits, services, errors);
+            state->observer = observer;
+
+            rxcpp::ComposableDisposable cd;
+
+            cd.Add(rxcpp::Disposable([=]{ state->cancel = true; }));
+
+            cd.Add(rxcpp::Subscribe(
+                sourceUris,
+            // on next
+                [=](const std::string& uri)
+                {
+                    if (is_local(uri)) {
+                        auto start = std::chrono::steady_clock::now();
+                        try {
+                            http::client::response response;
+                            if (!local_fetch(uri, services, response))
+                                return;
+                            std::unique_lock<std::mutex> guard(state->lock);
+                            if (!state->cancel)
+                                observer->OnNext(FetchedFeed(std::move(response), nullptr));
+                        } catch (...) {
+                            if (errors) {
+                                errors.report(uri, "local_fetch", std::current_exception(), start);
+                                return;
+                            }
+                            std::unique_lock<std::mutex> guard(state->lock);
+                            if (!state->cancel)
+                                observer->OnError(std::current_exception());
+                            state->cancel = true;
+                        }
+                        return;
+                    }
+                    std::chrono::steady_clock::time_point start;
+                    {
+                        std::unique_lock<std::mutex> guard(state->lock);
+                        if (uri.empty() || state->cancel || state->closed)
+                            return;
+                        ++services.fetches->pushed;
+                        if (!state->fetching.insert(normalize_uri(uri)).second) {
+                            ++services.fetches->skipped;
+                            return;
+                        }
+                        ++state->outstanding;
+                        start = std::chrono::steady_clock::now() + state->reserve(host_key(uri));
+                    }
+                    ReactorAttempt attempt;
+                    attempt.uri = uri;
+                    attempt.target = services.redirects->apply(uri);
+                    auto begin = [=]{
+                        auto delay = std::max(start - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero());
+                        reactor_fetch(state, attempt, delay);};
+                    if (services.budget) {
+                        // may be called from a release() on a stage's
+                        // thread, reactor_fetch takes none of its locks
+                        services.budget->when_available(begin);
+                    } else {
+                        begin();
+                    }
+                },
+            // on completed
+                [=]
+                {
+                    std::unique_lock<std::mutex> guard(state->lock);
+                    state->closed = true;
+                    if (state->outstanding == 0 && !state->cancel)
+                        observer->OnCompleted();
+                },
+            // on error
+                [=](const std::exception_ptr& error)
+                {
+                    std::unique_lock<std::mutex> guard(state->lock);
+                    if (!state->cancel)
+                        observer->OnError(error);
+                    state->cancel = true;
+                }));
+            return cd;
+        }
+    );
+}
+
+
 typedef std::shared_ptr<rapidxml::xml_document<>> shared_xmldoc;
 typedef std::tuple<http::client::response, shared_xmldoc> XmlDoc;
 typedef std::tuple<http::client::response, shared_xmldoc, rss::channel> RssChannel;
 typedef std::tuple<http::client::response, shared_xmldoc, atom::feed> AtomFeed;
 
-
+// parses the body of each response in place. the document emitted
+// shares ownership of the body, which lives as long as the document is
+// referenced. with a budget the body is moved from its fetched stage to
+// the parsed stage, along with the memory of the document. the
+// documents of local uris are mapped and parsed where they are mapped.
+// each subscription parses into documents from a pool of its own, which
+// are recycled when the last reference to them is gone, with blocks
+// sized to each feed from what schedule has learned of it.
 std::shared_ptr<rxcpp::Observable<XmlDoc>> XmlParse(
-    const HttpResponses& responses)
+    const HttpResponses& responses,
+    ErrorChannel errors = ErrorChannel(),
+    std::shared_ptr<MemoryBudget> budget = std::shared_ptr<MemoryBudget>(),
+    std::shared_ptr<LocalSources> locals = std::shared_ptr<LocalSources>(),
+    std::shared_ptr<PollSchedule> schedule = std::shared_ptr<PollSchedule>())
 {
     return rxcpp::CreateObservable<XmlDoc>(
         [=](std::shared_ptr<rxcpp::Observer<XmlDoc>> observer) 
@@ -172,6 +1264,8 @@ std::shared_ptr<rxcpp::Observable<XmlDoc>> XmlParse(
                 bool cancel;
             };
             auto state = std::make_shared<State>();
+            auto documents = std::make_shared<DocumentPool>();
+            auto sizing = std::make_shared<DocumentSizing>(schedule);
 
             rxcpp::ComposableDisposable cd;
 
@@ -180,16 +1274,41 @@ std::shared_ptr<rxcpp::Observable<XmlDoc>> XmlParse(
             cd.Add(rxcpp::Subscribe(
                 responses,
             // on next
-                [=](const http::client::response& response)
+                [=](const FetchedFeed& fetched)
                 {
+                    auto& response = std::get<0>(fetched);
+                    auto start = std::chrono::steady_clock::now();
                     try {
-                        auto doc = std::make_shared<rapidxml::xml_document<>>();
-                        std::string response_body = body(response);
-                        doc->parse<0>(const_cast<char*>(response_body.c_str()));
+                        std::string uri = source_of(response);
+                        std::shared_ptr<FeedBody> text = std::get<1>(fetched);
+                        if (!text) {
+                            std::unique_ptr<LocalDocument> local(new LocalDocument(
+                                uri, locals ? &locals->counters() : nullptr));
+                            text = std::make_shared<FeedBody>(std::move(local));
+                        } else if (budget) {
+                            budget->release(MemoryBudget::fetched, text->size());
+                        }
+                        text->adopt(documents->acquire(sizing->block_size(uri, text->size())));
+                        auto& parsing = text->document();
+                        parsing.parse<0>(text->data());
+                        if (text->truncated())
+                            throw std::runtime_error(uri + ": the file shrank while it was read");
+                        text->parsed();
+                        // the recycled blocks this feed did not fit go back
+                        // to the arena rather than being held with it
+                        parsing.trim();
+                        sizing->parsed(uri, text->size(), parsing);
+                        if (budget)
+                            text->charge(budget, text->size() + sizeof(FeedBody) +
+                                sizeof(rapidxml::xml_document<>) + parsing.dynamic_size());
+                        shared_xmldoc doc(text, &parsing);
                         if (!state->cancel)
                             observer->OnNext(XmlDoc(response, std::move(doc))); 
                     } catch (...) {
-                        observer->OnError(std::current_exception());
+                        if (errors)
+                            errors.report(source_of(response), "xml_parse", std::current_exception(), start);
+                        else
+                            observer->OnError(std::current_exception());
                     }
                 },
             // on completed
@@ -211,7 +1330,8 @@ std::shared_ptr<rxcpp::Observable<XmlDoc>> XmlParse(
 
 
 std::shared_ptr<rxcpp::Observable<RssChannel>> RssParse(
-    const std::shared_ptr<rxcpp::Observable<XmlDoc>>& responses)
+    const std::shared_ptr<rxcpp::Observable<XmlDoc>>& responses,
+    ErrorChannel errors = ErrorChannel())
 {
     return rxcpp::CreateObservable<RssChannel>(
         [=](std::shared_ptr<rxcpp::Observer<RssChannel>> observer) 
@@ -233,6 +1353,7 @@ std::shared_ptr<rxcpp::Observable<RssChannel>> RssParse(
             // on next
                 [=](const XmlDoc& item)
                 {
+                    auto start = std::chrono::steady_clock::now();
                     try {
                         auto response = std::get<0>(item);
                         auto doc = std::get<1>(item);
@@ -240,7 +1361,10 @@ std::shared_ptr<rxcpp::Observable<RssChannel>> RssParse(
                         if (!state->cancel)
                             observer->OnNext(RssChannel(std::move(response), std::move(doc), std::move(channel))); 
                     } catch (...) {
-                        observer->OnError(std::current_exception());
+                        if (errors)
+                            errors.report(source_of(std::get<0>(item)), "rss_parse", std::current_exception(), start);
+                        else
+                            observer->OnError(std::current_exception());
                     }
                 },
             // on completed
@@ -261,7 +1385,8 @@ std::shared_ptr<rxcpp::Observable<RssChannel>> RssParse(
 }
 
 std::shared_ptr<rxcpp::Observable<AtomFeed>> AtomParse(
-    const std::shared_ptr<rxcpp::Observable<XmlDoc>>& responses)
+    const std::shared_ptr<rxcpp::Observable<XmlDoc>>& responses,
+    ErrorChannel errors = ErrorChannel())
 {
     return rxcpp::CreateObservable<AtomFeed>(
         [=](std::shared_ptr<rxcpp::Observer<AtomFeed>> observer) 
@@ -283,6 +1408,7 @@ std::shared_ptr<rxcpp::Observable<AtomFeed>> AtomParse(
             // on next
                 [=](const XmlDoc& item)
                 {
+                    auto start = std::chrono::steady_clock::now();
                     try {
                         auto response = std::get<0>(item);
                         auto doc = std::get<1>(item);
@@ -290,7 +1416,10 @@ std::shared_ptr<rxcpp::Observable<AtomFeed>> AtomParse(
                         if (!state->cancel)
                             observer->OnNext(AtomFeed(std::move(response), std::move(doc), std::move(feed))); 
                     } catch (...) {
-                        observer->OnError(std::current_exception());
+                        if (errors)
+                            errors.report(source_of(std::get<0>(item)), "atom_parse", std::current_exception(), start);
+                        else
+                            observer->OnError(std::current_exception());
                     }
                 },
             // on completed
@@ -311,8 +1440,8 @@ std::shared_ptr<rxcpp::Observable<AtomFeed>> AtomParse(
 }
 
 std::shared_ptr<rxcpp::Observable<Item>> AtomEntries(
-    const std::shared_ptr<rxcpp::Observable<AtomFeed>>& responses
-)
+    const std::shared_ptr<rxcpp::Observable<AtomFeed>>& responses,
+    ErrorChannel errors = ErrorChannel())
 {
     return rxcpp::CreateObservable<Item>(
         [=](std::shared_ptr<rxcpp::Observer<Item>> observer) 
@@ -334,6 +1463,7 @@ std::shared_ptr<rxcpp::Observable<Item>> AtomEntries(
             // on next
                 [=](const AtomFeed& item)
                 {
+                    auto start = std::chrono::steady_clock::now();
                     try {
                         if(state->cancel) return ;
                         auto& feed = std::get<2>(item);
@@ -344,7 +1474,10 @@ std::shared_ptr<rxcpp::Observable<Item>> AtomEntries(
                             entry));
                         }
                     } catch (...) {
-                        observer->OnError(std::current_exception());
+                        if (errors)
+                            errors.report(source_of(std::get<0>(item)), "atom_entries", std::current_exception(), start);
+                        else
+                            observer->OnError(std::current_exception());
                     }
                 },
             // on completed
@@ -366,7 +1499,8 @@ std::shared_ptr<rxcpp::Observable<Item>> AtomEntries(
 
 
 std::shared_ptr<rxcpp::Observable<Item>> RssEntries(
-    const std::shared_ptr<rxcpp::Observable<RssChannel>>& responses)
+    const std::shared_ptr<rxcpp::Observable<RssChannel>>& responses,
+    ErrorChannel errors = ErrorChannel())
 {
     return rxcpp::CreateObservable<Item>(
         [=](std::shared_ptr<rxcpp::Observer<Item>> observer) 
@@ -388,6 +1522,7 @@ std::shared_ptr<rxcpp::Observable<Item>> RssEntries(
             // on next
                 [=](const RssChannel& item)
                 {
+                    auto start = std::chrono::steady_clock::now();
                     try {
                         if(state->cancel) return ;
                         auto& channel = std::get<2>(item);
@@ -398,18 +1533,131 @@ std::shared_ptr<rxcpp::Observable<Item>> RssEntries(
                             entry));
                         }
                     } catch (...) {
-                        observer->OnError(std::current_exception());
+                        if (errors)
+                            errors.report(source_of(std::get<0>(item)), "rss_entries", std::current_exception(), start);
+                        else
+                            observer->OnError(std::current_exception());
+                    }
+                },
+            // on completed
+                [=]
+                {
+                    if (!state->cancel)
+                        observer->OnCompleted(); 
+                },
+            // on error
+                [=](const std::exception_ptr& error)
+                {
+                    if (!state->cancel)
+                        observer->OnError(error);
+                }));
+            return cd;
+        }
+    );
+}
+
+// extracts the entries of each body without parsing it into a document,
+// in place of XmlParse and the stages after it, and emits each entry as
+// soon as it is read. the documents of local uris are mapped and read
+// where they are mapped. the ttl an rss channel asks for is hinted to
+// schedule. the entries that the fetch stage extracted as the bodies
+// arrived, FetchServices::entries, come from streamed and are emitted
+// along with these.
+std::shared_ptr<rxcpp::Observable<Item>> StreamEntries(
+    const HttpResponses& responses,
+    ErrorChannel errors = ErrorChannel(),
+    std::shared_ptr<MemoryBudget> budget = std::shared_ptr<MemoryBudget>(),
+    std::shared_ptr<LocalSources> locals = std::shared_ptr<LocalSources>(),
+    std::shared_ptr<PollSchedule> schedule = std::shared_ptr<PollSchedule>(),
+    std::shared_ptr<rxcpp::Observable<Item>> streamed = std::shared_ptr<rxcpp::Observable<Item>>())
+{
+    return rxcpp::CreateObservable<Item>(
+        [=](std::shared_ptr<rxcpp::Observer<Item>> observer) 
+        -> rxcpp::Disposable
+        {
+            struct State 
+            {
+                State() : cancel(false) {}
+                std::atomic<bool> cancel;
+                // serializes calls to observer from the two sources
+                std::mutex emit;
+            };
+            auto state = std::make_shared<State>();
+
+            rxcpp::ComposableDisposable cd;
+
+            cd.Add(rxcpp::Disposable([=]{ state->cancel = true; }));
+
+            if (streamed) {
+                cd.Add(rxcpp::Subscribe(
+                    streamed,
+                // on next
+                    [=](const Item& item)
+                    {
+                        std::unique_lock<std::mutex> guard(state->emit);
+                        if (!state->cancel)
+                            observer->OnNext(item);
+                    },
+                // on completed, the responses complete the entries
+                    [=]
+                    {
+                    },
+                // on error
+                    [=](const std::exception_ptr& error)
+                    {
+                    }));
+            }
+
+            cd.Add(rxcpp::Subscribe(
+                responses,
+            // on next
+                [=](const FetchedFeed& fetched)
+                {
+                    auto& response = std::get<0>(fetched);
+                    auto start = std::chrono::steady_clock::now();
+                    std::string uri = source_of(response);
+                    std::shared_ptr<FeedBody> text = std::get<1>(fetched);
+                    try {
+                        if (!text) {
+                            std::unique_ptr<LocalDocument> local(new LocalDocument(
+                                uri, locals ? &locals->counters() : nullptr));
+                            text = std::make_shared<FeedBody>(std::move(local));
+                        }
+                        FeedStream feed([&](const FeedStream& f, const FeedStream::Entry& e){
+                            std::unique_lock<std::mutex> guard(state->emit);
+                            if (!state->cancel)
+                                observer->OnNext(make_item(response, f, e));});
+                        feed.write(text->data(), text->size());
+                        feed.finish();
+                        if (text->truncated())
+                            throw std::runtime_error(uri + ": the file shrank while it was read");
+                        text->parsed();
+                        auto& source = feed.source();
+                        if (schedule && !feed.atom())
+                            schedule->hint(uri, PollSchedule::feed_ttl,
+                                feed_update_interval(source.ttl, source.update_period, source.update_frequency));
+                    } catch (...) {
+                        if (errors) {
+                            errors.report(uri, "stream_entries", std::current_exception(), start);
+                        } else {
+                            std::unique_lock<std::mutex> guard(state->emit);
+                            observer->OnError(std::current_exception());
+                        }
                     }
+                    if (budget && std::get<1>(fetched))
+                        budget->release(MemoryBudget::fetched, text->size());
                 },
             // on completed
                 [=]
                 {
+                    std::unique_lock<std::mutex> guard(state->emit);
                     if (!state->cancel)
                         observer->OnCompleted(); 
                 },
             // on error
                 [=](const std::exception_ptr& error)
                 {
+                    std::unique_lock<std::mutex> guard(state->emit);
                     if (!state->cancel)
                         observer->OnError(error);
                 }));
@@ -427,6 +1675,20 @@ auto rxcpp_chain(http_get&&, Arg&& ...arg)
     return HttpGet(std::forward<Arg>(arg)...);
 }
 
+struct http_get_concurrent {};
+template<class... Arg>
+auto rxcpp_chain(http_get_concurrent&&, Arg&& ...arg)
+-> decltype(HttpGetConcurrent(std::forward<Arg>(arg)...)) {
+    return HttpGetConcurrent(std::forward<Arg>(arg)...);
+}
+
+struct http_get_reactor {};
+template<class... Arg>
+auto rxcpp_chain(http_get_reactor&&, Arg&& ...arg)
+-> decltype(HttpGetReactor(std::forward<Arg>(arg)...)) {
+    return HttpGetReactor(std::forward<Arg>(arg)...);
+}
+
 struct xml_parse {};
 template<class... Arg>
 std::shared_ptr<rxcpp::Observable<XmlDoc>> 
@@ -463,6 +1725,13 @@ auto rxcpp_chain(rss_entries&&, Arg&& ...arg)
   return RssEntries(std::forward<Arg>(arg)...);
 }
 
+struct stream_entries {};
+template<class... Arg>
+auto rxcpp_chain(stream_entries&&, Arg&& ...arg) 
+  -> decltype(StreamEntries(std::forward<Arg>(arg)...)) {
+  return StreamEntries(std::forward<Arg>(arg)...);
+}
+
 }
 
 std::regex content_type_regex("^([a-z]+)[/]([a-z]+)(?:\\+([a-z]+))?(?:;\\s*charset=([a-z0-9\\-]+))?");
@@ -490,13 +1759,616 @@ ContentType extract_content_type(const std::string& input)
     throw std::range_error("search key not found");
 }
 
+// true for the content type of an xml document, text/xml,
+// application/xml or a type with a +xml suffix. throws when field is not
+// a content type.
+bool xml_content_type(const std::string& field)
+{
+    ContentType contentType = extract_content_type(field);
+    return (contentType.top == "application" || contentType.top == "text") &&
+        (!contentType.format.empty() ? contentType.format == "xml": contentType.sub == "xml");
+}
+
+// sets distinct to the feeds to poll, from the command line and then
+// the feed list. a feed listed twice, under another spelling or under
+// the address it redirects to, is polled once and the https spelling is
+// kept. local uris are only the same when they are spelled the same.
+void distinct_feeds(
+    const std::vector<std::string>& feeds,
+    const UriTable& list,
+    RedirectCache& redirects,
+    UriTable& distinct)
+{
+    size_t count = feeds.size() + list.end();
+    auto candidate = [&](size_t index){
+        return index < feeds.size() ? feeds[index] : list.str(static_cast<UriTable::id_type>(index - feeds.size()));};
+    UriTable keys;
+    // the candidate kept for each key, and the key of each candidate
+    std::vector<size_t> kept;
+    std::vector<UriTable::id_type> keyOf;
+    keyOf.reserve(count);
+    for (size_t index = 0; index < count; ++index) {
+        if (index >= feeds.size() && !list.contains(static_cast<UriTable::id_type>(index - feeds.size()))) {
+            keyOf.push_back(UriTable::npos);
+            continue;
+        }
+        std::string feed = candidate(index);
+        auto key = keys.intern(is_local(feed) ? feed : feed_key(redirects.apply(feed)));
+        if (key == kept.size()) {
+            kept.push_back(index);
+        } else if (candidate(kept[key]).compare(0, 8, "https://") != 0 && feed.compare(0, 8, "https://") == 0) {
+            kept[key] = index;
+        }
+        keyOf.push_back(key);
+    }
+    distinct.clear();
+    for (size_t index = 0; index < count; ++index) {
+        if (keyOf[index] != UriTable::npos && kept[keyOf[index]] == index) {
+            distinct.intern(candidate(index));
+        }
+    }
+}
+
+// the feeds polled, and the feed list they are read from. the list is
+// read again when its file changes: the feeds still listed keep their
+// state in the schedule, the ones no longer listed are removed and new
+// ones are added.
+struct FeedListReload
+{
+    typedef PollSchedule::clock clock;
+
+    FeedListReload()
+        : duplicates(0)
+        , reloads(0)
+        , added(0)
+        , removed(0)
+        , failed(0)
+        , read_time(0)
+        , distinct_time(0)
+        , schedule_time(0)
+    {}
+
+    std::unique_ptr<FeedListFile> file;
+    // the feeds given on the command line
+    std::vector<std::string> feeds;
+    std::shared_ptr<RedirectCache> redirects;
+    std::shared_ptr<PollSchedule> schedule;
+    // the entries seen of each feed, when fetches stop at them
+    std::shared_ptr<SeenEntries> seen;
+    // the bytes transferred for each feed, under the uri it is requested by
+    std::shared_ptr<TransferStats> transfers;
+    UriTable polled;
+    size_t duplicates;
+    clock::duration interval;
+    clock::time_point next_check;
+    size_t reloads;
+    size_t added;
+    size_t removed;
+    size_t failed;
+    // the time the first load of the list took, by step
+    clock::duration read_time;
+    clock::duration distinct_time;
+    clock::duration schedule_time;
+
+    // the first load, throws when the list cannot be read
+    void load()
+    {
+        auto start = clock::now();
+        UriTable listed;
+        if (file) {
+            file->read(listed);
+        }
+        auto read = clock::now();
+        distinct_feeds(feeds, listed, *redirects, polled);
+        duplicates = feeds.size() + listed.size() - polled.size();
+        auto deduplicated = clock::now();
+        for (UriTable::id_type id = 0; id < polled.end(); ++id) {
+            schedule->add(polled.str(id));
+        }
+        auto scheduled = clock::now();
+        read_time = read - start;
+        distinct_time = deduplicated - read;
+        schedule_time = scheduled - deduplicated;
+        next_check = scheduled + interval;
+    }
+
+    // reloads the list if the check is due and the file has changed.
+    // a list that cannot be read is reported, the feeds are kept.
+    void check(clock::time_point now)
+    {
+        if (!file || now < next_check) {
+            return;
+        }
+        next_check = now + interval;
+        try {
+            if (file->changed()) {
+                reload(now);
+            }
+        } catch (std::exception& e) {
+            ++failed;
+            std::cerr << "feed list: " << e.what() << std::endl;
+        }
+    }
+
+    // reads the list, if there is one, whether or not it has changed
+    // and reconciles the schedule with it and the feeds. throws when the
+    // list cannot be read.
+    void reload(clock::time_point now)
+    {
+        UriTable listed;
+        if (file && !file->read(listed)) {
+            return;
+        }
+        UriTable distinct;
+        distinct_feeds(feeds, listed, *redirects, distinct);
+        for (UriTable::id_type id = 0; id < polled.end(); ++id) {
+            if (polled.contains(id) && distinct.find(polled.data(id), polled.size(id)) == UriTable::npos) {
+                schedule->remove(polled.str(id));
+                if (seen)
+                    seen->forget(polled.str(id));
+                if (transfers) {
+                    transfers->forget(polled.str(id));
+                    transfers->forget(redirects->apply(polled.str(id)));
+                }
+                ++removed;
+            }
+        }
+        for (UriTable::id_type id = 0; id < distinct.end(); ++id) {
+            if (polled.find(distinct.data(id), distinct.size(id)) == UriTable::npos) {
+                schedule->add(distinct.str(id), now);
+                ++added;
+            }
+        }
+        std::swap(polled, distinct);
+        duplicates = feeds.size() + listed.size() - polled.size();
+        ++reloads;
+    }
+};
+
+// the signals acted on when running as a daemon. SIGTERM and SIGINT
+// start a drain, a second one exits at once. SIGHUP asks for the
+// configuration to be read again.
+struct DaemonSignals : std::enable_shared_from_this<DaemonSignals>
+{
+    DaemonSignals() : terminate(false), hangup(false) {}
+
+    std::atomic<bool> terminate;
+    std::atomic<bool> hangup;
+
+    // blocks the signals in this thread, and so in every thread started
+    // from it after, and waits for them on a thread of its own. must be
+    // called before any other thread is started.
+    void start()
+    {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGTERM);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGHUP);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        auto self = shared_from_this();
+        std::thread([self, signals]{
+            for (;;) {
+                int signal = 0;
+                if (sigwait(&signals, &signal) != 0) {
+                    continue;
+                }
+                if (signal == SIGHUP) {
+                    self->hangup = true;
+                } else if (self->terminate.exchange(true)) {
+                    std::_Exit(1);
+                }
+            }
+        }).detach();
+    }
+};
+
+// waits for the subscribers at the end of the pipeline to complete
+struct Drain
+{
+    typedef std::chrono::steady_clock clock;
+
+    explicit Drain(size_t subscribers) : open(subscribers) {}
+
+    // a subscriber completed or failed
+    void done()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if (open > 0 && --open == 0) {
+            drained.notify_all();
+        }
+    }
+
+    // returns false when deadline passes first
+    bool wait_until(clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        return drained.wait_until(guard, deadline, [&]{ return open == 0; });
+    }
+
+    std::mutex lock;
+    std::condition_variable drained;
+    size_t open;
+};
+
+// appends a line for each entry of an atom or rss document, as the
+// pipeline prints them but with the source of the document
+size_t extract_items(const std::string& source, rapidxml::xml_document<>& doc, std::string& out)
+{
+    auto root = doc.first_node();
+    std::string name = root ? root->name() : "";
+    size_t items = 0;
+    if (name == "feed") {
+        atom::feed f(doc);
+        for (auto& e : f) {
+            out.append("atom: ").append(source).append(" (").append(f.title()).append(") ").append(e.title()).append("\n");
+            ++items;
+        }
+    } else if (name == "rss") {
+        rss::channel c(doc);
+        for (auto& i : c) {
+            out.append("rss : ").append(source).append(" (").append(c.title()).append(") ").append(i.title()).append("\n");
+            ++items;
+        }
+    } else {
+        throw std::runtime_error("not an atom or rss document: " + name);
+    }
+    return items;
+}
+
+void print_arena_stats(std::ostream& out)
+{
+    auto arena = xml_arena_stats();
+    out << "arena: "
+        << arena.reserved << " bytes reserved" << (arena.huge_pages ? " on huge pages, " : ", ")
+        << arena.in_use << " in use, "
+        << arena.high_water << " at most, "
+        << arena.fresh << " blocks fresh, "
+        << arena.cached << " from the thread cache, "
+        << arena.central << " from the central cache, "
+        << arena.contended << " of " << arena.locks << " locks contended" << std::endl;
+    rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+        out << "memory: " << usage.ru_maxrss << " KB peak rss" << std::endl;
+    }
+}
+
+// extracts the entries of the archived documents under paths to output,
+// or to stdout, rather than polling feeds
+int backfill(const std::vector<std::string>& paths, size_t threads, const std::string& output)
+{
+    std::ofstream file;
+    if (!output.empty()) {
+        file.open(output, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "cannot open " << output << std::endl;
+            return 1;
+        }
+    }
+    std::mutex failures;
+    Backfill corpus(
+        threads,
+        &extract_items,
+        output.empty() ? std::cout : file,
+        [&](const std::string& source, const std::exception_ptr& e){
+            std::unique_lock<std::mutex> guard(failures);
+            try {
+                std::rethrow_exception(e);
+            } catch (std::exception& reason) {
+                std::cerr << "error: backfill " << source << ": " << reason.what() << std::endl;
+            }});
+    Backfill::Stats stats;
+    try {
+        stats = corpus.run(paths);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    double seconds = std::max(1e-9, std::chrono::duration<double>(stats.elapsed).count());
+    std::cerr << "backfill: "
+        << stats.files << " files, "
+        << stats.documents << " documents, "
+        << stats.failed << " failed, "
+        << stats.items << " items in "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(stats.elapsed).count() << "ms, "
+        << static_cast<size_t>(stats.documents / seconds) << " documents/s, "
+        << stats.bytes / seconds / (1024 * 1024) << " MB/s" << std::endl;
+    print_arena_stats(std::cerr);
+    return stats.failed ? 2 : 0;
+}
+
 int main(int argc, char* argv[]) {
 
-  if (argc < 2) {
-    std::cout << "Usage: " << argv[0] << " <url>..." << std::endl;
+  namespace po = boost::program_options;
+
+  FetchLimits limits;
+  ConnectionLimits connectionLimits;
+  size_t idleTimeout = 30;
+  PollPolicy pollPolicy;
+  size_t minInterval = 5;
+  size_t maxInterval = 6 * 60 * 60;
+  std::vector<std::string> feeds;
+  std::vector<std::string> hostRates;
+  FetchDeadlines deadlines;
+  size_t firstByteTimeout = 10;
+  size_t totalTimeout = 30;
+  size_t retryBackoff = 500;
+  bool isolateErrors = false;
+  std::string backend = "netlib";
+  ResolverPolicy resolverPolicy;
+  std::string redirectsFile;
+  size_t negativeTtl = 30;
+  TlsPolicy tlsPolicy;
+  size_t memoryBudget = 256;
+  bool stopAtSeen = false;
+  std::vector<std::string> backfillPaths;
+  std::string feedListPath;
+  size_t feedListCheck = 5;
+  std::string backfillOutput;
+  size_t threads = 0;
+  std::string configPath;
+  bool daemon = false;
+  size_t drainTimeout = 10;
+  bool hugePages = false;
+  bool stream = false;
+
+  po::options_description options("Options");
+  options.add_options()
+    ("help", "print this message")
+    ("config", po::value<std::string>(&configPath),
+      "file of options as name = value lines, the command line takes precedence")
+    ("daemon", po::bool_switch(&daemon),
+      "poll until SIGTERM or SIGINT rather than for 15 seconds, SIGHUP reads the options again")
+    ("drain-timeout", po::value<size_t>(&drainTimeout)->default_value(drainTimeout),
+      "seconds a daemon waits on SIGTERM for the fetches and parses in flight to finish")
+    ("max-in-flight", po::value<size_t>(&limits.max_in_flight)->default_value(limits.max_in_flight),
+      "most fetches outstanding at once")
+    ("max-per-host", po::value<size_t>(&limits.max_per_host)->default_value(limits.max_per_host),
+      "most fetches outstanding against one host")
+    ("max-decoded", po::value<size_t>(&limits.max_decoded)->default_value(limits.max_decoded),
+      "largest body accepted after gzip/deflate decoding, in bytes")
+    ("host-rate", po::value<double>(&limits.host_rate)->default_value(limits.host_rate),
+      "requests per second started against one host, 0 is unlimited")
+    ("host-burst", po::value<double>(&limits.host_burst)->default_value(limits.host_burst),
+      "requests that may be started at once against an idle host")
+    ("host-rate-for", po::value<std::vector<std::string>>(&hostRates),
+      "host=rate, overrides --host-rate for one host name")
+    ("global-rate", po::value<double>(&limits.global_rate)->default_value(limits.global_rate),
+      "requests per second started in total, 0 is unlimited")
+    ("global-burst", po::value<double>(&limits.global_burst)->default_value(limits.global_burst),
+      "requests that may be started at once in total")
+    ("first-byte-timeout", po::value<size_t>(&firstByteTimeout)->default_value(firstByteTimeout),
+      "seconds to connect and receive the response headers")
+    ("total-timeout", po::value<size_t>(&totalTimeout)->default_value(totalTimeout),
+      "seconds to receive the whole response")
+    ("max-retries", po::value<size_t>(&deadlines.max_retries)->default_value(deadlines.max_retries),
+      "retries after a timeout, network error or 429/5xx status")
+    ("retry-backoff", po::value<size_t>(&retryBackoff)->default_value(retryBackoff),
+      "milliseconds before the first retry, doubled for each retry after")
+    ("hedge", po::bool_switch(&deadlines.hedge),
+      "start a second request when a feed is slower than its p95 latency")
+    ("isolate-errors", po::bool_switch(&isolateErrors),
+      "report a failed feed on the error channel and carry on, rather than stopping")
+    ("backend", po::value<std::string>(&backend)->default_value(backend),
+      "netlib for a blocking client per fetch, or epoll, io_uring or auto for one reactor thread")
+    ("resolver-threads", po::value<size_t>(&resolverPolicy.workers)->default_value(resolverPolicy.workers),
+      "host name lookups run at once")
+    ("negative-ttl", po::value<size_t>(&negativeTtl)->default_value(negativeTtl),
+      "seconds a host name that does not exist is remembered")
+    ("redirects", po::value<std::string>(&redirectsFile),
+      "file the permanent redirects are loaded from and saved to")
+    ("ca-file", po::value<std::string>(&tlsPolicy.ca_file),
+      "PEM certificates trusted for https besides the system's, with a reactor backend")
+    ("idle-timeout", po::value<size_t>(&idleTimeout)->default_value(idleTimeout),
+      "seconds an idle keep-alive connection is kept open")
+    ("min-interval", po::value<size_t>(&minInterval)->default_value(minInterval),
+      "seconds between polls of a feed that changes on every poll")
+    ("max-interval", po::value<size_t>(&maxInterval)->default_value(maxInterval),
+      "seconds between polls of a feed that never changes")
+    ("jitter", po::value<double>(&pollPolicy.jitter)->default_value(pollPolicy.jitter),
+      "fraction by which each poll interval is randomly stretched or shrunk")
+    ("memory-budget", po::value<size_t>(&memoryBudget)->default_value(memoryBudget),
+      "megabytes of fetched bodies and parsed documents held before fetches are paused, 0 is unlimited")
+    ("stop-at-seen", po::bool_switch(&stopAtSeen),
+      "with a reactor backend, stop receiving a feed at the first entry printed by an earlier poll, once a whole fetch showed it lists its newest entries first")
+    ("feed-list", po::value<std::string>(&feedListPath),
+      "OPML or text file, a uri per line, of feeds to poll besides the ones given as arguments")
+    ("feed-list-check", po::value<size_t>(&feedListCheck)->default_value(feedListCheck),
+      "seconds between checks for a change to --feed-list, which is then reloaded")
+    ("backfill", po::value<std::vector<std::string>>(&backfillPaths),
+      "extract the entries of the archived documents in a file or directory and exit, rather than polling")
+    ("backfill-output", po::value<std::string>(&backfillOutput),
+      "file the backfilled entries are written to, rather than stdout")
+    ("threads", po::value<size_t>(&threads)->default_value(threads),
+      "documents backfilled at once, 0 is one per core")
+    ("stream", po::bool_switch(&stream),
+      "extract the entries of each feed as it is read rather than from a parsed document, with a reactor backend as it is received")
+    ("huge-pages", po::bool_switch(&hugePages),
+      "map the memory of the parsed documents on huge pages where the system allows it")
+    ("uri", po::value<std::vector<std::string>>(&feeds), "feed to poll, a file:// uri or - for the document on stdin");
+
+  po::positional_options_description positional;
+  positional.add("uri", -1);
+
+  // the command line, then the --config file. read again on SIGHUP,
+  // without notify, so that only the options a reload applies are taken
+  // from vm and the variables bound to the others keep their values.
+  auto readOptions = [&](po::variables_map& vm, bool notify){
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+    if (vm.count("config")) {
+      std::string path = vm["config"].as<std::string>();
+      std::ifstream file(path);
+      if (!file) {
+        throw std::runtime_error("cannot open " + path);
+      }
+      po::store(po::parse_config_file(file, options), vm);
+    }
+    if (notify) {
+      po::notify(vm);
+    }
+  };
+
+  try {
+    po::variables_map vm;
+    readOptions(vm, true);
+    if (vm.count("help")) {
+      feeds.clear();
+      feedListPath.clear();
+      backfillPaths.clear();
+    }
+    for (auto& hostRate : hostRates) {
+      auto equals = hostRate.rfind('=');
+      if (equals == std::string::npos) {
+        throw std::invalid_argument("--host-rate-for expects host=rate, not " + hostRate);
+      }
+      std::string host = hostRate.substr(0, equals);
+      std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+      limits.host_rates[host] = std::stod(hostRate.substr(equals + 1));
+    }
+    if (backend != "netlib" && backend != "epoll" && backend != "io_uring" && backend != "auto") {
+      throw std::invalid_argument("--backend expects netlib, epoll, io_uring or auto, not " + backend);
+    }
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    feeds.clear();
+    feedListPath.clear();
+    backfillPaths.clear();
+  }
+
+  xml_arena_use_huge_pages(hugePages);
+
+  if (!backfillPaths.empty()) {
+    return backfill(backfillPaths, threads, backfillOutput);
+  }
+
+  if (feeds.empty() && feedListPath.empty()) {
+    std::cout << "Usage: " << argv[0] << " [options] <url|file://path|->..." << std::endl;
+    std::cout << "       " << argv[0] << " [options] --feed-list <file> [<url>...]" << std::endl;
+    std::cout << "       " << argv[0] << " [options] --backfill <path>..." << std::endl;
+    std::cout << options << std::endl;
     return 1;
   }
 
+  // before any other thread is started, so that they all leave the
+  // signals to it
+  std::shared_ptr<DaemonSignals> signals;
+  if (daemon) {
+    signals = std::make_shared<DaemonSignals>();
+    signals->start();
+  }
+
+  deadlines.first_byte = std::chrono::seconds(firstByteTimeout);
+  deadlines.total = std::chrono::seconds(std::max(firstByteTimeout, totalTimeout));
+  deadlines.retry_backoff = std::chrono::milliseconds(retryBackoff);
+
+  // a hedged request needs a connection of its own
+  connectionLimits.max_per_host = limits.max_per_host * (deadlines.hedge ? 2 : 1);
+  connectionLimits.idle_timeout = std::chrono::seconds(idleTimeout);
+  auto connections = std::make_shared<ConnectionPool>(connectionLimits);
+  auto validators = std::make_shared<ValidatorCache>();
+  auto transfers = std::make_shared<TransferStats>();
+
+  auto redirects = std::make_shared<RedirectCache>();
+  if (!redirectsFile.empty()) {
+    redirects->load(redirectsFile);
+  }
+
+  pollPolicy.min_interval = std::chrono::seconds(minInterval);
+  pollPolicy.max_interval = std::chrono::seconds(std::max(minInterval, maxInterval));
+  auto schedule = std::make_shared<PollSchedule>(pollPolicy);
+
+  auto feedList = std::make_shared<FeedListReload>();
+  if (!feedListPath.empty()) {
+    feedList->file.reset(new FeedListFile(feedListPath));
+  }
+  feedList->feeds = feeds;
+  feedList->redirects = redirects;
+  feedList->schedule = schedule;
+  feedList->transfers = transfers;
+  feedList->interval = std::chrono::seconds(std::max<size_t>(1, feedListCheck));
+  try {
+    feedList->load();
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  FetchServices services;
+  services.deadlines = deadlines;
+  services.connections = connections;
+  services.validators = validators;
+  services.transfers = transfers;
+  services.schedule = schedule;
+  services.redirects = redirects;
+  services.fetches = std::make_shared<FetchCounters>();
+  services.latencies = std::make_shared<LatencyHistory>();
+  services.timeouts = std::make_shared<DeadlineCounters>();
+  services.budget = std::make_shared<MemoryBudget>(memoryBudget * 1024 * 1024);
+  services.locals = std::make_shared<LocalSources>();
+  if (stopAtSeen) {
+    services.seen = std::make_shared<SeenEntries>();
+    feedList->seen = services.seen;
+  }
+  resolverPolicy.negative_ttl = std::chrono::seconds(negativeTtl);
+  services.resolver = std::make_shared<ResolverCache>(resolverPolicy);
+
+  std::shared_ptr<TlsContext> tls;
+  if (backend != "netlib") {
+    HttpReactorLimits reactorLimits;
+    reactorLimits.max_in_flight = limits.max_in_flight;
+    reactorLimits.max_per_host = limits.max_per_host;
+    reactorLimits.max_idle_per_host = connectionLimits.max_per_host;
+    reactorLimits.idle_timeout = connectionLimits.idle_timeout;
+    reactorLimits.max_body = limits.max_decoded;
+    try {
+      tls = std::make_shared<TlsContext>(tlsPolicy);
+      services.reactor = std::make_shared<HttpReactor>(reactorLimits,
+        backend == "epoll" ? HttpReactor::epoll :
+        backend == "io_uring" ? HttpReactor::io_uring : HttpReactor::automatic,
+        services.resolver, tls);
+    } catch (std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  auto failures = std::make_shared<FailureCounters>();
+
+  // on SIGHUP the options are read again. the feeds, the feed list, the
+  // poll intervals and the jitter take effect, the caches, pools and the
+  // state of each feed are kept. the other options keep the values
+  // started with.
+  size_t configReloads = 0;
+  auto reload = [&]{
+    try {
+      po::variables_map vm;
+      readOptions(vm, false);
+      size_t reloadMin = vm["min-interval"].as<size_t>();
+      size_t reloadMax = vm["max-interval"].as<size_t>();
+      pollPolicy.min_interval = std::chrono::seconds(reloadMin);
+      pollPolicy.max_interval = std::chrono::seconds(std::max(reloadMin, reloadMax));
+      pollPolicy.jitter = vm["jitter"].as<double>();
+      schedule->set_policy(pollPolicy);
+      feedList->feeds = vm.count("uri") ? vm["uri"].as<std::vector<std::string>>() : std::vector<std::string>();
+      std::string listPath = vm.count("feed-list") ? vm["feed-list"].as<std::string>() : std::string();
+      if (listPath.empty()) {
+        feedList->file.reset();
+      } else if (!feedList->file || feedList->file->path() != listPath) {
+        feedList->file.reset(new FeedListFile(listPath));
+      }
+      feedList->reload(PollSchedule::clock::now());
+      ++configReloads;
+      std::cerr << "reloaded options, " << feedList->polled.size() << " feeds" << std::endl;
+    } catch (std::exception& e) {
+      std::cerr << "reload: " << e.what() << std::endl;
+    }
+  };
+
+  // the atom and rss subscribers, or the one of --stream
+  auto drain = std::make_shared<Drain>(stream ? 1 : 2);
+  bool drained = true;
+  Drain::clock::duration drainTime(0);
+
   try {
     auto newthread = std::make_shared<rxcpp::NewThreadScheduler>();
     auto output = std::make_shared<rxcpp::EventLoopScheduler>();
@@ -504,96 +2376,163 @@ int main(int argc, char* argv[]) {
 
     auto uris = rxcpp::CreateSubject<std::string>();
 
+    ErrorChannel errors;
+    if (isolateErrors) {
+      auto feedErrors = rxcpp::CreateSubject<FeedError>();
+      errors.observer = feedErrors;
+      errors.failures = failures;
+      errors.emit = std::make_shared<std::mutex>();
+
+      from(feedErrors)
+        .observe_on(output)
+        .subscribe([](const FeedError& e){
+          std::cerr << "error: " << e.stage << " " << e.uri << " after " 
+            << std::chrono::duration_cast<std::chrono::milliseconds>(e.duration).count() << "ms: " 
+            << e.reason << std::endl;});
+    }
+
+    // with --stream and a reactor, the entries of each body are
+    // extracted as it is received and reach StreamEntries through this
+    std::shared_ptr<rxcpp::Observable<Item>> streamed;
+    if (stream && services.reactor) {
+      auto entries = rxcpp::CreateSubject<Item>();
+      services.entries = entries;
+      streamed = entries;
+    }
+
     // get docs via http
-    auto responsesByContentType = from(uris)
-      .observe_on(newthread)
-      .chain<News::http_get>()
-      .group_by([](const http::client::response& response){
-        std::string contentType;
-        response.get_headers(
-          "Content-Type", 
-          [&](std::string const& name, std::string const& value){
-            contentType = value;});
-        return contentType;}
-      );
-
-    // parse xml docs
-    auto xmlDocsByRoot = from(responsesByContentType)
-      .where([](const std::shared_ptr<rxcpp::GroupedObservable<std::string, http::client::response>>& grsp){
-        auto contentTypeField = grsp->Key();
-        auto contentType = extract_content_type(contentTypeField);
-        if ((contentType.top == "application" || contentType.top == "text") &&
-          (!contentType.format.empty() ? contentType.format == "xml": contentType.sub == "xml")) {
-          return true;
-        }
-        return false;}
-      )
-      .select_many()
-      .observe_on(newthread)
-      .chain<News::xml_parse>()
-      .group_by([](const XmlDoc& doc){
-        std::string name;
-        auto docNode = std::get<1>(doc)->first_node();
-        if (docNode) {
-          name = std::get<1>(doc)->first_node()->name();
-        }
-        return name;
-      });
+    HttpResponses responses = services.reactor
+      ? HttpGetReactor(uris, limits, services, errors)
+      : HttpGetConcurrent(uris, limits, services, errors);
+    // keep the xml responses. they are sorted by content type one at a
+    // time, so a response that is dropped is released from the budget.
+    auto budget = services.budget;
+    auto isXml = [=](const FetchedFeed& fetched){
+      auto& response = std::get<0>(fetched);
+      std::string contentTypeField;
+      response.get_headers(
+        "Content-Type", 
+        [&](std::string const& name, std::string const& value){
+          contentTypeField = value;});
+      bool xml = false;
+      try {
+        xml = xml_content_type(contentTypeField);
+      } catch (...) {
+        if (!errors) {
+          throw;
+        }
+        // responses of this content type are not xml, drop them
+        failures->record("content_type");
+      }
+      if (!xml && std::get<1>(fetched)) {
+        budget->release(MemoryBudget::fetched, std::get<1>(fetched)->size());
+      }
+      return xml;};
+
+    // the entries printed are the ones a later poll can stop at
+    auto seen = services.seen;
 
     std::exception_ptr error;
     rxcpp::ComposableDisposable cd;
+    // the subscriptions, disposed when a drain runs out of time
+    rxcpp::ComposableDisposable pipeline;
       
     rxcpp::SharedDisposable sd;
     cd.Add(sd);
 
-    // parse and print atom feeds
-    from(xmlDocsByRoot)
-      .where([](const std::shared_ptr<rxcpp::GroupedObservable<std::string, XmlDoc>>& grsp){
-        auto rootNode = grsp->Key();
-        return rootNode == "feed";}
-      )
-      .select_many()
-      .observe_on(newthread)
-      .chain<News::atom_parse>()
-      .chain<News::atom_entries>()
-      .observe_on(output)
-      .subscribe([=](const Item& i){
-          std::cout << "atom: (" << i.source.title << ") " << i.data.title << std::endl;},
-          [](){},
-          [&](const std::exception_ptr& e){
-              error = e; cd.Dispose(); uris->OnError(e);}
-      );
-
-    // parse and print rss feeds
-    from(xmlDocsByRoot)
-      .where([](const std::shared_ptr<rxcpp::GroupedObservable<std::string, XmlDoc>>& grsp){
-        auto rootNode = grsp->Key();
-        return rootNode == "rss";}
-      )
-      .select_many()
-      .observe_on(newthread)
-      .chain<News::rss_parse>()
-      .chain<News::rss_entries>()
-      .observe_on(output)
-      .subscribe([=](const Item& i){
-          std::cout << "rss : (" << i.source.title << ") " << i.data.title << std::endl;},
-          [](){},
-          [&](const std::exception_ptr& e){
-              error = e; cd.Dispose(); uris->OnError(e);}
-      );
-
-
-      // exit in 15 seconds
-      cd.Add(output->Schedule(
-          std::chrono::seconds(15),
-          [=](rxcpp::Scheduler::shared) {
-              std::cout << "your 15 seconds of fame are up!" << std::endl;
-              cd.Dispose();
-              uris->OnCompleted();
-              return rxcpp::Disposable::Empty();
-          }));
-
-      // send in the uris every 5 seconds
+    if (stream) {
+      // extract and print the entries of both formats without documents
+      pipeline.Add(from(responses)
+        .where(isXml)
+        .observe_on(newthread)
+        .chain<News::stream_entries>(errors, budget, services.locals, schedule, streamed)
+        .observe_on(output)
+        .subscribe([=](const Item& i){
+            std::cout << (i.source.format == "atom" ? "atom: (" : "rss : (") << i.source.title << ") " << i.data.title << std::endl;
+            if (seen) {
+              seen->delivered(i.source.uri, i.data.id);
+            }},
+            [=](){ drain->done(); },
+            [&](const std::exception_ptr& e){
+                error = e; cd.Dispose(); drain->done(); uris->OnError(e);}
+        ));
+    } else {
+      auto xmlDocsByRoot = from(responses)
+        .where(isXml)
+        .observe_on(newthread)
+        .chain<News::xml_parse>(errors, budget, services.locals, schedule)
+        .group_by([](const XmlDoc& doc){
+          std::string name;
+          auto docNode = std::get<1>(doc)->first_node();
+          if (docNode) {
+            name = std::get<1>(doc)->first_node()->name();
+          }
+          return name;
+        });
+
+      // parse and print atom feeds
+      pipeline.Add(from(xmlDocsByRoot)
+        .where([](const std::shared_ptr<rxcpp::GroupedObservable<std::string, XmlDoc>>& grsp){
+          auto rootNode = grsp->Key();
+          return rootNode == "feed";}
+        )
+        .select_many()
+        .observe_on(newthread)
+        .chain<News::atom_parse>(errors)
+        .chain<News::atom_entries>(errors)
+        .observe_on(output)
+        .subscribe([=](const Item& i){
+            std::cout << "atom: (" << i.source.title << ") " << i.data.title << std::endl;
+            if (seen) {
+              seen->delivered(i.source.uri, i.data.id);
+            }},
+            [=](){ drain->done(); },
+            [&](const std::exception_ptr& e){
+                error = e; cd.Dispose(); drain->done(); uris->OnError(e);}
+        ));
+
+      // parse and print rss feeds
+      pipeline.Add(from(xmlDocsByRoot)
+        .where([](const std::shared_ptr<rxcpp::GroupedObservable<std::string, XmlDoc>>& grsp){
+          auto rootNode = grsp->Key();
+          return rootNode == "rss";}
+        )
+        .select_many()
+        .observe_on(newthread)
+        .chain<News::rss_parse>(errors)
+        .select([=](const RssChannel& channel) -> RssChannel {
+          std::string uri;
+          std::get<0>(channel).get_source(uri);
+          auto& c = std::get<2>(channel);
+          schedule->hint(uri, PollSchedule::feed_ttl, feed_update_interval(c.ttl(), c.update_period(), c.update_frequency()));
+          return channel;}
+        )
+        .chain<News::rss_entries>(errors)
+        .observe_on(output)
+        .subscribe([=](const Item& i){
+            std::cout << "rss : (" << i.source.title << ") " << i.data.title << std::endl;
+            if (seen) {
+              seen->delivered(i.source.uri, i.data.id);
+            }},
+            [=](){ drain->done(); },
+            [&](const std::exception_ptr& e){
+                error = e; cd.Dispose(); drain->done(); uris->OnError(e);}
+        ));
+    }
+
+      // exit in 15 seconds, a daemon runs until it is signalled
+      if (!signals) {
+        cd.Add(output->Schedule(
+            std::chrono::seconds(15),
+            [=](rxcpp::Scheduler::shared) {
+                std::cout << "your 15 seconds of fame are up!" << std::endl;
+                cd.Dispose();
+                uris->OnCompleted();
+                return rxcpp::Disposable::Empty();
+            }));
+      }
+
+      // send in the uris as the schedule says they are due
       sd.Set(output->Schedule(
          rxcpp::fix0([=](
              rxcpp::Scheduler::shared s,
@@ -601,11 +2540,30 @@ int main(int argc, char* argv[]) {
          -> rxcpp::Disposable
          {
              try {
-                 for (int cursor = 1; cursor < argc; ++cursor){
-                     uris->OnNext(argv[cursor]);
+                 if (signals && signals->hangup.exchange(false)) {
+                     reload();
+                 }
+                 if (signals && signals->terminate) {
+                     // no more polls are started, the ones in flight
+                     // run on to the end of the pipeline
+                     std::cerr << "draining" << std::endl;
+                     uris->OnCompleted();
+                     return rxcpp::Disposable::Empty();
+                 }
+                 connections->prune();
+                 feedList->check(PollSchedule::clock::now());
+                 for (auto& uri : schedule->due()){
+                     uris->OnNext(uri);
+                 }
+                 auto now = PollSchedule::clock::now();
+                 auto next = schedule->next_due();
+                 std::chrono::milliseconds wait(1000);
+                 if (next != PollSchedule::clock::time_point::max()) {
+                     wait = std::min(wait, std::max(std::chrono::milliseconds(10),
+                         std::chrono::duration_cast<std::chrono::milliseconds>(next - now)));
                  }
                  sd.Set(s->Schedule(
-                    std::chrono::seconds(5), 
+                    wait, 
                     std::move(self)));
              } catch (...) {
                  uris->OnError(std::current_exception());
@@ -615,14 +2573,212 @@ int main(int argc, char* argv[]) {
 
       // wait until time to exit 
       from(uris).for_each([=](const std::string& i){});
+      if (signals && !error) {
+          auto start = Drain::clock::now();
+          drained = drain->wait_until(start + std::chrono::seconds(drainTimeout));
+          drainTime = Drain::clock::now() - start;
+          if (!drained) {
+              pipeline.Dispose();
+          }
+      }
       if (error) {
           std::rethrow_exception(error);}
   }
   catch (std::exception& e) {
     std::cerr << e.what() << std::endl;
   }
+  // the workers held off by the budget give up
+  services.budget->close();
+
+  if (signals) {
+    std::cout << "daemon: "
+      << configReloads << " reloads, "
+      << (drained ? "drained in " : "drain abandoned after ")
+      << std::chrono::duration_cast<std::chrono::milliseconds>(drainTime).count() << "ms" << std::endl;
+  }
+
+  auto connectionStats = connections->stats();
+  std::cout << "connections: " 
+    << connectionStats.hits << " reused, " 
+    << connectionStats.misses << " new, " 
+    << connectionStats.expired << " expired, " 
+    << connectionStats.discarded << " discarded, " 
+    << connectionStats.gave_up << " waits given up" << std::endl;
+
+  if (services.reactor) {
+    auto& reactorCounters = services.reactor->counters();
+    std::cout << "reactor: " << services.reactor->backend() << ", "
+      << reactorCounters.requests << " requests, "
+      << reactorCounters.failed << " failed, "
+      << reactorCounters.connections << " connections, "
+      << reactorCounters.reused << " reused, "
+      << reactorCounters.syscalls << " syscalls, "
+      << reactorCounters.submissions << " submissions" << std::endl;
+
+    auto tlsStats = tls->stats();
+    std::chrono::nanoseconds fullCpu = tlsStats.full_cpu / std::max<size_t>(1, tlsStats.full);
+    std::chrono::nanoseconds resumedCpu = tlsStats.resumed_cpu / std::max<size_t>(1, tlsStats.resumed);
+    // each resumed handshake would otherwise have been a full one
+    std::chrono::nanoseconds savedCpu(0);
+    if (tlsStats.full && fullCpu > resumedCpu) {
+      savedCpu = (fullCpu - resumedCpu) * tlsStats.resumed;
+    }
+    std::cout << "tls: "
+      << tlsStats.full << " full handshakes ("
+      << std::chrono::duration_cast<std::chrono::microseconds>(fullCpu).count() << "us cpu each), "
+      << tlsStats.resumed << " resumed ("
+      << std::chrono::duration_cast<std::chrono::microseconds>(resumedCpu).count() << "us cpu each), "
+      << tlsStats.failed << " failed, "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(savedCpu).count() << "ms cpu saved by resumption" << std::endl;
+  }
+
+  auto budgetStats = services.budget->stats();
+  auto megabytes = [](size_t bytes){ return bytes / (1024.0 * 1024.0); };
+  std::cout << "memory budget: " << megabytes(services.budget->limit()) << "MB, "
+    << megabytes(budgetStats.bytes[MemoryBudget::fetched]) << "MB fetched ("
+    << megabytes(budgetStats.peak[MemoryBudget::fetched]) << "MB peak), "
+    << megabytes(budgetStats.bytes[MemoryBudget::parsed]) << "MB parsed ("
+    << megabytes(budgetStats.peak[MemoryBudget::parsed]) << "MB peak), "
+    << megabytes(budgetStats.peak_total) << "MB peak in total, "
+    << budgetStats.pauses << " fetches paused for "
+    << std::chrono::duration_cast<std::chrono::milliseconds>(budgetStats.paused).count() << "ms" << std::endl;
+
+  if (services.seen) {
+    auto seenStats = services.seen->stats();
+    std::cout << "stop at seen: "
+      << seenStats.stopped << " fetches stopped at a seen entry, "
+      << seenStats.unchanged << " with nothing new, "
+      << seenStats.received << " of " << seenStats.advertised << " advertised body bytes received, "
+      << seenStats.checked << " fetched whole to check the order, "
+      << seenStats.unordered << " with a new entry after a seen one" << std::endl;
+  }
+
+  auto& localStats = services.locals->counters();
+  if (localStats.mapped + localStats.read) {
+    std::cout << "local: "
+      << localStats.mapped << " documents mapped (" << localStats.mapped_bytes << " bytes), "
+      << localStats.read << " read from a pipe (" << localStats.read_bytes << " bytes)" << std::endl;
+  }
+
+  auto& bodies = body_counters();
+  std::cout << "bodies: "
+    << bodies.bodies << " documents of " << bodies.bytes << " bytes, "
+    << bodies.copies << " copies of " << bodies.copied_bytes << " bytes, "
+    << (bodies.bodies ? bodies.copied_bytes / bodies.bodies : 0) << " bytes copied per document" << std::endl;
+
+  auto& pooled = document_pool_counters();
+  std::cout << "documents: "
+    << pooled.acquired << " parsed in " << pooled.created << " documents, "
+    << pooled.blocks << " blocks of " << pooled.block_bytes << " bytes, "
+    << (pooled.acquired ? double(pooled.created + pooled.blocks) / pooled.acquired : 0.0) << " allocations per feed" << std::endl;
+
+  print_arena_stats(std::cout);
+
+  auto resolverStats = services.resolver->stats();
+  auto resolverAnswers = resolverStats.hits + resolverStats.negative_hits + resolverStats.misses;
+  std::cout << "resolver: "
+    << resolverStats.hits << " hits, "
+    << resolverStats.negative_hits << " negative hits, "
+    << resolverStats.misses << " misses (" << resolverStats.coalesced << " coalesced), "
+    << resolverStats.failures << " failures, "
+    << (resolverAnswers ? 100 * (resolverStats.hits + resolverStats.negative_hits) / resolverAnswers : 0) << "% hit rate, "
+    << std::chrono::duration_cast<std::chrono::milliseconds>(
+         resolverStats.lookup_time / std::max<size_t>(1, resolverStats.lookups)).count() << "ms mean lookup, "
+    << std::chrono::duration_cast<std::chrono::milliseconds>(resolverStats.slowest).count() << "ms slowest" << std::endl;
+
+  auto redirectStats = redirects->stats();
+  std::cout << "redirects: "
+    << redirectStats.applied << " round trips avoided, "
+    << redirectStats.learned << " learned, "
+    << redirectStats.followed << " followed, "
+    << redirectStats.loops << " loops, "
+    << feedList->duplicates << " duplicate feeds dropped" << std::endl;
+  if (!redirectsFile.empty()) {
+    try {
+      redirects->save(redirectsFile);
+    } catch (std::exception& e) {
+      std::cerr << e.what() << std::endl;
+    }
+  }
+
+  auto validatorStats = validators->stats();
+  std::cout << "validators: " 
+    << validatorStats.conditional << " conditional, " 
+    << validatorStats.not_modified << " not modified, " 
+    << validatorStats.modified << " modified, " 
+    << validatorStats.bytes_saved << " bytes saved" << std::endl;
+
+  // the totals, and the feeds with the most bytes on the wire
+  auto transferFeeds = transfers->feeds();
+  TransferStats::Transfer transferTotal;
+  std::vector<TransferStats::Feeds::const_iterator> heaviest;
+  for (auto feed = transferFeeds.cbegin(); feed != transferFeeds.cend(); ++feed) {
+    transferTotal.responses += feed->second.responses;
+    transferTotal.wire += feed->second.wire;
+    transferTotal.decoded += feed->second.decoded;
+    heaviest.push_back(feed);
+  }
+  size_t heaviestShown = std::min<size_t>(heaviest.size(), 10);
+  std::partial_sort(heaviest.begin(), heaviest.begin() + heaviestShown, heaviest.end(),
+    [](TransferStats::Feeds::const_iterator a, TransferStats::Feeds::const_iterator b){
+      return a->second.wire > b->second.wire;});
+  std::cout << "transfers: "
+    << transferFeeds.size() << " feeds, "
+    << transferTotal.responses << " responses, "
+    << transferTotal.wire << " bytes on the wire, "
+    << transferTotal.decoded << " bytes decoded" << std::endl;
+  for (size_t feed = 0; feed < heaviestShown; ++feed) {
+    std::cout << "transfer: " << heaviest[feed]->first << " "
+      << heaviest[feed]->second.responses << " responses, "
+      << heaviest[feed]->second.wire << " bytes on the wire, "
+      << heaviest[feed]->second.decoded << " bytes decoded" << std::endl;
+  }
+
+  std::cout << "fetches: " 
+    << services.fetches->pushed << " polls, " 
+    << services.fetches->coalesced << " coalesced, " 
+    << services.fetches->skipped << " skipped, " 
+    << services.fetches->deferred << " deferred by rate limits" << std::endl;
+
+  std::cout << "deadlines: " 
+    << services.timeouts->timeouts << " timeouts, " 
+    << services.timeouts->retries << " retries, " 
+    << services.timeouts->hedges << " hedges, " 
+    << services.timeouts->hedge_wins << " won by the hedge" << std::endl;
+
+  for (auto& stage : failures->stages()) {
+    std::cout << "failures: " << stage.first << " " << stage.second << std::endl;
+  }
+
+  if (feedList->file) {
+    std::cout << "feed list: "
+      << feedList->polled.size() << " feeds polled, loaded in "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(feedList->read_time).count() << "ms read, "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(feedList->distinct_time).count() << "ms deduplicated, "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(feedList->schedule_time).count() << "ms scheduled, "
+      << schedule->bytes() / 1024 << "KB held by the schedule, "
+      << feedList->reloads << " reloads, "
+      << feedList->added << " added, "
+      << feedList->removed << " removed, "
+      << feedList->failed << " failed" << std::endl;
+  }
+
+  auto pollStats = schedule->stats();
+  std::cout << "polls: " 
+    << pollStats.polls << " polls, " 
+    << pollStats.changed << " changed, " 
+    << pollStats.unchanged << " unchanged, " 
+    << pollStats.failed << " failed" << std::endl;
 
   std::cout << "exiting" << std::endl;
 
+  // a drain that ran out of time may leave netlib requests blocked on
+  // detached threads, until their deadline abandons them. the process
+  // ends without destroying the statics they still use.
+  if (!drained) {
+    std::cout.flush();
+    std::_Exit(0);
+  }
+
   return 0;
 }
@@ -0,0 +1,124 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "memory_budget.hpp"
+#include <algorithm>
+
+MemoryBudget::MemoryBudget(size_t limit)
+  : budget(limit)
+  , closed(false)
+  , total(0)
+{
+}
+
+bool MemoryBudget::over() const
+{
+  return budget != 0 && total > budget;
+}
+
+void MemoryBudget::charge(Stage stage, size_t bytes)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  counters.bytes[stage] += bytes;
+  counters.peak[stage] = std::max(counters.peak[stage], counters.bytes[stage]);
+  total += bytes;
+  counters.peak_total = std::max(counters.peak_total, total);
+}
+
+void MemoryBudget::release(Stage stage, size_t bytes)
+{
+  std::deque<Pending> resumed;
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    bytes = std::min(bytes, counters.bytes[stage]);
+    counters.bytes[stage] -= bytes;
+    total -= bytes;
+    if (over()) {
+      return;
+    }
+    if (!closed) {
+      auto now = clock::now();
+      for (auto& waiting : pending) {
+        counters.paused += now - waiting.since;
+      }
+      resumed.swap(pending);
+    }
+  }
+  available.notify_all();
+  for (auto& waiting : resumed) {
+    waiting.resume();
+  }
+}
+
+bool MemoryBudget::exceeded() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return over();
+}
+
+bool MemoryBudget::wait()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  if (!closed && over()) {
+    ++counters.pauses;
+    auto since = clock::now();
+    available.wait(guard, [this]{ return closed || !over(); });
+    counters.paused += clock::now() - since;
+  }
+  return !closed;
+}
+
+void MemoryBudget::when_available(std::function<void()> resume)
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    if (closed) {
+      return;
+    }
+    if (over()) {
+      ++counters.pauses;
+      Pending waiting;
+      waiting.resume = std::move(resume);
+      waiting.since = clock::now();
+      pending.push_back(std::move(waiting));
+      return;
+    }
+  }
+  resume();
+}
+
+void MemoryBudget::close()
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    closed = true;
+    pending.clear();
+  }
+  available.notify_all();
+}
+
+MemoryBudget::Stats MemoryBudget::stats() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return counters;
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#pragma once
+#ifndef ___MEMORY_BUDGET_INC__
+#define ___MEMORY_BUDGET_INC__
+
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+// bytes held between the stages of the pipeline: bodies that have been
+// fetched and wait to be parsed, and documents that have been parsed and
+// wait for their entries to be printed. the fetch stage checks the
+// budget before it starts a request and holds off while the stages
+// together hold more than the limit. a request that is already in
+// flight is not stopped, so the limit can be passed by the bodies of
+// the requests in flight.
+class MemoryBudget
+{
+public:
+  typedef std::chrono::steady_clock clock;
+
+  enum Stage { fetched, parsed, stages };
+
+  struct Stats
+  {
+    Stats() : peak_total(0), pauses(0), paused(0)
+    {
+      for (int stage = 0; stage < stages; ++stage) {
+        bytes[stage] = 0;
+        peak[stage] = 0;
+      }
+    }
+    // held now, and at most, by each stage
+    size_t bytes[stages];
+    size_t peak[stages];
+    // the most held by the stages together
+    size_t peak_total;
+    // fetches held off, and for how long in total
+    size_t pauses;
+    clock::duration paused;
+  };
+
+  // a limit of zero is unlimited
+  explicit MemoryBudget(size_t limit);
+
+  void charge(Stage stage, size_t bytes);
+  void release(Stage stage, size_t bytes);
+
+  // true while the stages hold more than the limit
+  bool exceeded() const;
+
+  // blocks while the budget is exceeded. returns false once closed.
+  bool wait();
+
+  // calls resume once the budget is not exceeded, right away or from
+  // the release() that brings it under. resume must not take a lock
+  // that a caller of release() may hold.
+  void when_available(std::function<void()> resume);
+
+  // wakes the waiters, wait() returns false from here on and resumes
+  // that are pending or come later are dropped
+  void close();
+
+  size_t limit() const { return budget; }
+  Stats stats() const;
+
+private:
+  MemoryBudget(const MemoryBudget&);
+  MemoryBudget& operator=(const MemoryBudget&);
+
+  struct Pending
+  {
+    std::function<void()> resume;
+    clock::time_point since;
+  };
+
+  // must hold lock
+  bool over() const;
+
+  size_t budget;
+  mutable std::mutex lock;
+  std::condition_variable available;
+  std::deque<Pending> pending;
+  bool closed;
+  size_t total;
+  Stats counters;
+};
+
+#endif  // ___MEMORY_BUDGET_INC__
@@ -0,0 +1,350 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "poll_schedule.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+
+namespace {
+typedef PollSchedule::clock clock;
+
+clock::duration scaled(clock::duration interval, double factor)
+{
+  return std::chrono::duration_cast<clock::duration>(interval * factor);
+}
+}
+
+PollSchedule::PollSchedule(PollPolicy p)
+  : policy(p)
+  , random(std::random_device()())
+  , origin(clock::now())
+  , wheel(0)
+{
+  policy.jitter = std::min(std::max(policy.jitter, 0.0), 1.0);
+  policy.resolution = std::max(policy.resolution, clock::duration(std::chrono::milliseconds(1)));
+}
+
+void PollSchedule::set_policy(PollPolicy p)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  p.resolution = policy.resolution;
+  p.jitter = std::min(std::max(p.jitter, 0.0), 1.0);
+  policy = p;
+}
+
+TimingWheel::tick_type PollSchedule::tick(clock::time_point when) const
+{
+  if (when <= origin) {
+    return 0;
+  }
+  return static_cast<TimingWheel::tick_type>((when - origin) / policy.resolution);
+}
+
+PollSchedule::Feed* PollSchedule::find(const std::string& uri)
+{
+  auto id = uris.find(uri);
+  if (id == UriTable::npos) {
+    return nullptr;
+  }
+  return &feeds[id];
+}
+
+clock::duration PollSchedule::floor(const Feed& feed) const
+{
+  clock::duration result = policy.min_interval;
+  for (auto& hint : feed.hints) {
+    result = std::max(result, hint);
+  }
+  return result;
+}
+
+clock::duration PollSchedule::jittered(clock::duration interval)
+{
+  std::uniform_real_distribution<double> factor(1.0 - policy.jitter, 1.0 + policy.jitter);
+  return scaled(interval, factor(random));
+}
+
+void PollSchedule::reschedule(Feed& feed, clock::time_point next)
+{
+  wheel.cancel(feed.timer);
+  feed.next = next;
+  // round up so a feed is never polled before it is due
+  feed.timer = wheel.insert(tick(next + policy.resolution - clock::duration(1)), feed.id);
+}
+
+void PollSchedule::add(const std::string& uri, clock::time_point now)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  if (uris.find(uri) != UriTable::npos) {
+    return;
+  }
+  std::uint32_t id = uris.intern(uri);
+  if (id == feeds.size()) {
+    feeds.push_back(Feed());
+  } else {
+    feeds[id] = Feed();
+  }
+
+  Feed& feed = feeds[id];
+  feed.id = id;
+  feed.interval = policy.min_interval;
+  feed.change_interval = clock::duration::zero();
+  std::fill(std::begin(feed.hints), std::end(feed.hints), clock::duration::zero());
+  feed.last_poll = clock::time_point();
+  std::uniform_real_distribution<double> spread(0.0, policy.jitter);
+  reschedule(feed, now + scaled(feed.interval, spread(random)));
+}
+
+void PollSchedule::remove(const std::string& uri)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto id = uris.find(uri);
+  if (id == UriTable::npos) {
+    return;
+  }
+  wheel.cancel(feeds[id].timer);
+  feeds[id] = Feed();
+  uris.erase(id);
+}
+
+std::vector<std::string> PollSchedule::due(clock::time_point now)
+{
+  std::vector<std::string> result;
+  std::unique_lock<std::mutex> guard(lock);
+  wheel.advance(tick(now), [&](std::uint32_t id){
+    Feed& feed = feeds[id];
+    feed.timer = TimingWheel::Timer();
+    feed.last_poll = now;
+    ++counters.polls;
+    result.push_back(uris.str(id));
+    reschedule(feed, now + jittered(feed.interval));});
+  return result;
+}
+
+clock::time_point PollSchedule::next_due() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  if (wheel.empty()) {
+    return clock::time_point::max();
+  }
+  return origin + policy.resolution * wheel.next_deadline();
+}
+
+clock::duration PollSchedule::settled(const Feed& feed) const
+{
+  // poll twice per observed change so a change is seen within half of
+  // the change interval on average
+  clock::duration result = feed.change_interval == clock::duration::zero() ?
+    policy.min_interval : feed.change_interval / 2;
+  return std::min(std::max(result, floor(feed)), std::max(policy.max_interval, floor(feed)));
+}
+
+void PollSchedule::changed(const std::string& uri, clock::time_point now)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  if (Feed* feed = find(uri)) {
+    changed(*feed, now);
+  }
+}
+
+void PollSchedule::unchanged(const std::string& uri, clock::time_point now)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  if (Feed* feed = find(uri)) {
+    unchanged(*feed, now);
+  }
+}
+
+void PollSchedule::fetched(const std::string& uri, size_t digest, clock::time_point now)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  Feed* feed = find(uri);
+  if (!feed) {
+    return;
+  }
+  if (feed->digest == digest && feed->last_change != clock::time_point()) {
+    unchanged(*feed, now);
+  } else {
+    feed->digest = digest;
+    changed(*feed, now);
+  }
+}
+
+void PollSchedule::changed(Feed& feed, clock::time_point now)
+{
+  ++counters.changed;
+  if (feed.last_change != clock::time_point()) {
+    clock::duration observed = now - feed.last_change;
+    feed.change_interval = feed.change_interval == clock::duration::zero() ?
+      observed : (feed.change_interval * 3 + observed) / 4;
+  }
+  feed.last_change = now;
+  feed.errors = 0;
+  feed.interval = settled(feed);
+  reschedule(feed, now + jittered(feed.interval));
+}
+
+void PollSchedule::unchanged(Feed& feed, clock::time_point now)
+{
+  ++counters.unchanged;
+  if (feed.errors) {
+    feed.errors = 0;
+    feed.interval = settled(feed);
+  }
+  // back off, but not far past the interval the feed is known to change at
+  clock::duration most = policy.max_interval;
+  if (feed.change_interval != clock::duration::zero()) {
+    most = std::min(most, feed.change_interval);
+  }
+  feed.interval = std::min(scaled(feed.interval, policy.unchanged_backoff), std::max(most, feed.interval));
+  feed.interval = std::max(feed.interval, floor(feed));
+  reschedule(feed, now + jittered(feed.interval));
+}
+
+void PollSchedule::failed(const std::string& uri, clock::time_point now)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  Feed* found = find(uri);
+  if (!found) {
+    return;
+  }
+  Feed& feed = *found;
+  ++counters.failed;
+  ++feed.errors;
+  feed.interval = std::min(scaled(feed.interval, policy.error_backoff), std::max(policy.max_error_interval, feed.interval));
+  feed.interval = std::max(feed.interval, floor(feed));
+  reschedule(feed, now + jittered(feed.interval));
+}
+
+void PollSchedule::hint(const std::string& uri, Hint source, clock::duration least)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  Feed* found = find(uri);
+  if (!found || source >= hint_count) {
+    return;
+  }
+  Feed& feed = *found;
+  // a server asking for days between polls is held to the longest
+  // interval the policy allows
+  feed.hints[source] = std::min(std::max(least, clock::duration::zero()), policy.max_interval);
+  clock::duration least_interval = floor(feed);
+  if (feed.interval < least_interval) {
+    feed.interval = least_interval;
+  }
+  // hints arrive after the outcome of the poll was reported
+  if (feed.last_poll != clock::time_point() && feed.next < feed.last_poll + least_interval) {
+    reschedule(feed, feed.last_poll + jittered(least_interval));
+  }
+}
+
+double PollSchedule::node_ratio(const std::string& uri) const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto id = uris.find(uri);
+  return id == UriTable::npos ? 0 : feeds[id].node_ratio;
+}
+
+void PollSchedule::set_node_ratio(const std::string& uri, double ratio)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  Feed* found = find(uri);
+  if (found) {
+    found->node_ratio = static_cast<float>(ratio);
+  }
+}
+
+size_t PollSchedule::size() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return uris.size();
+}
+
+PollSchedule::Stats PollSchedule::stats() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return counters;
+}
+
+size_t PollSchedule::bytes() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return uris.bytes() + feeds.capacity() * sizeof(Feed);
+}
+
+std::chrono::seconds cache_control_max_age(const std::string& cacheControl)
+{
+  std::string value = cacheControl;
+  std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+  if (value.find("no-cache") != std::string::npos || value.find("no-store") != std::string::npos) {
+    return std::chrono::seconds::zero();
+  }
+  std::string::size_type cursor = 0;
+  while ((cursor = value.find("max-age", cursor)) != std::string::npos) {
+    // skip s-maxage and the like
+    bool directive = cursor == 0 || value[cursor - 1] == ',' || ::isspace(static_cast<unsigned char>(value[cursor - 1]));
+    cursor += 7;
+    while (cursor < value.size() && ::isspace(static_cast<unsigned char>(value[cursor]))) {
+      ++cursor;
+    }
+    if (directive && cursor < value.size() && value[cursor] == '=') {
+      ++cursor;
+      if (cursor < value.size() && value[cursor] == '"') {
+        ++cursor;
+      }
+      return std::chrono::seconds(std::strtol(value.c_str() + cursor, nullptr, 10));
+    }
+  }
+  return std::chrono::seconds::zero();
+}
+
+std::chrono::seconds feed_update_interval(
+    const std::string& ttl,
+    const std::string& updatePeriod,
+    const std::string& updateFrequency)
+{
+  std::chrono::seconds result(0);
+  if (!ttl.empty()) {
+    result = std::chrono::minutes(std::max(0L, std::strtol(ttl.c_str(), nullptr, 10)));
+  }
+
+  std::string period = updatePeriod;
+  period.erase(std::remove_if(period.begin(), period.end(), ::isspace), period.end());
+  std::transform(period.begin(), period.end(), period.begin(), ::tolower);
+  long seconds = 0;
+  if (period == "hourly") {
+    seconds = 60 * 60;
+  } else if (period == "daily") {
+    seconds = 24 * 60 * 60;
+  } else if (period == "weekly") {
+    seconds = 7 * 24 * 60 * 60;
+  } else if (period == "monthly") {
+    seconds = 30 * 24 * 60 * 60;
+  } else if (period == "yearly") {
+    seconds = 365 * 24 * 60 * 60;
+  }
+  if (seconds) {
+    long frequency = updateFrequency.empty() ? 1 : std::strtol(updateFrequency.c_str(), nullptr, 10);
+    result = std::max(result, std::chrono::seconds(seconds / std::max(1L, frequency)));
+  }
+  return result;
+}
@@ -0,0 +1,183 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___POLL_SCHEDULE_INC__
+#define ___POLL_SCHEDULE_INC__
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <mutex>
+#include "timing_wheel.hpp"
+#include "uri_table.hpp"
+
+struct PollPolicy
+{
+  PollPolicy()
+    : min_interval(std::chrono::seconds(5))
+    , max_interval(std::chrono::hours(6))
+    , max_error_interval(std::chrono::hours(1))
+    , unchanged_backoff(1.5)
+    , error_backoff(2.0)
+    , jitter(0.1)
+    , resolution(std::chrono::milliseconds(100))
+  {}
+  // no feed is polled more often than this
+  std::chrono::steady_clock::duration min_interval;
+  // unchanged feeds back off to no more than this
+  std::chrono::steady_clock::duration max_interval;
+  // failing feeds back off to no more than this
+  std::chrono::steady_clock::duration max_error_interval;
+  // interval multiplier for each unchanged poll
+  double unchanged_backoff;
+  // interval multiplier for each consecutive failed poll
+  double error_backoff;
+  // each interval is scaled by a random factor in [1 - jitter, 1 + jitter]
+  double jitter;
+  // polls are due on ticks of this length
+  std::chrono::steady_clock::duration resolution;
+};
+
+// decides when each feed is next polled. the interval tracks the
+// observed time between changes, backs off while a feed is unchanged
+// or failing and never drops below the interval the server asks for
+// with Cache-Control: max-age or the feed asks for with <ttl> or
+// sy:updatePeriod.
+//
+// due times are kept in a TimingWheel, so adding, rescheduling and
+// expiring a feed are O(1) however many feeds are registered. the uris
+// are interned in a UriTable and the state of each feed is kept in an
+// array by its id, so a large list of feeds stays compact.
+class PollSchedule
+{
+public:
+  typedef std::chrono::steady_clock clock;
+
+  enum Hint {
+    // Cache-Control: max-age from the response
+    cache_control,
+    // <ttl>, sy:updatePeriod and sy:updateFrequency from the feed
+    feed_ttl,
+    hint_count
+  };
+
+  struct Stats
+  {
+    Stats() : polls(0), changed(0), unchanged(0), failed(0) {}
+    size_t polls;
+    size_t changed;
+    size_t unchanged;
+    size_t failed;
+  };
+
+  explicit PollSchedule(PollPolicy policy);
+
+  // takes effect as each feed is next rescheduled. the resolution is
+  // kept as it was.
+  void set_policy(PollPolicy policy);
+
+  // new feeds are spread over the first jittered interval
+  void add(const std::string& uri, clock::time_point now = clock::now());
+  void remove(const std::string& uri);
+
+  // the feeds due at now, each provisionally rescheduled one interval
+  // later in case no outcome is reported for the poll.
+  std::vector<std::string> due(clock::time_point now = clock::now());
+
+  // the tick on which the next feed is due, or time_point::max() if
+  // no feeds are registered
+  clock::time_point next_due() const;
+
+  // outcomes of a poll, each reschedules the feed from now
+  void changed(const std::string& uri, clock::time_point now = clock::now());
+  // a full response whose body hashed to digest, changed when the digest differs from the last one
+  void fetched(const std::string& uri, size_t digest, clock::time_point now = clock::now());
+  void unchanged(const std::string& uri, clock::time_point now = clock::now());
+  void failed(const std::string& uri, clock::time_point now = clock::now());
+
+  // the least interval the server or the feed asks for, zero to clear
+  void hint(const std::string& uri, Hint source, clock::duration least);
+
+  // the bytes of parsed nodes per byte of text of a feed, as learned by
+  // DocumentSizing, zero until the feed has been parsed. it is kept
+  // with the rest of the state of the feed and goes when it is removed.
+  double node_ratio(const std::string& uri) const;
+  void set_node_ratio(const std::string& uri, double ratio);
+
+  size_t size() const;
+  Stats stats() const;
+  // the memory held for the feeds
+  size_t bytes() const;
+
+private:
+  struct Feed
+  {
+    Feed() : id(0), digest(0), errors(0), node_ratio(0) {}
+    std::uint32_t id;
+    TimingWheel::Timer timer;
+    clock::duration interval;
+    // average time between observed changes, zero until two are seen
+    clock::duration change_interval;
+    clock::time_point last_change;
+    clock::time_point next;
+    clock::time_point last_poll;
+    clock::duration hints[hint_count];
+    size_t digest;
+    size_t errors;
+    float node_ratio;
+  };
+
+  clock::duration floor(const Feed& feed) const;
+  clock::duration settled(const Feed& feed) const;
+  clock::duration jittered(clock::duration interval);
+  void changed(Feed& feed, clock::time_point now);
+  void unchanged(Feed& feed, clock::time_point now);
+  void reschedule(Feed& feed, clock::time_point next);
+  Feed* find(const std::string& uri);
+  TimingWheel::tick_type tick(clock::time_point when) const;
+
+  PollPolicy policy;
+  mutable std::mutex lock;
+  std::mt19937 random;
+  clock::time_point origin;
+  TimingWheel wheel;
+  // feeds by the id of their uri, the wheel holds ids. ids of removed
+  // feeds are reused.
+  UriTable uris;
+  std::vector<Feed> feeds;
+  Stats counters;
+};
+
+// parses the max-age directive of a Cache-Control value. returns zero
+// when absent, or when no-cache or no-store are present.
+std::chrono::seconds cache_control_max_age(const std::string& cacheControl);
+
+// the interval implied by an rss <ttl> (minutes) and the syndication
+// module's sy:updatePeriod and sy:updateFrequency, zero when absent.
+std::chrono::seconds feed_update_interval(
+    const std::string& ttl,
+    const std::string& updatePeriod,
+    const std::string& updateFrequency);
+
+#endif  // ___POLL_SCHEDULE_INC__
@@ -388,7 +388,9 @@ namespace rapidxml
         
         //! Constructs empty pool with default allocator functions.
         memory_pool()
-            : m_alloc_func(0)
+            : m_spare(0)
+            , m_block_size(RAPIDXML_DYNAMIC_POOL_SIZE)
+            , m_alloc_func(0)
             , m_free_func(0)
         {
             init();
@@ -527,15 +529,63 @@ namespace rapidxml
             while (m_begin != m_static_memory)
             {
                 char *previous_begin = reinterpret_cast<header *>(align(m_begin))->previous_begin;
-                if (m_free_func)
-                    m_free_func(m_begin);
-                else
-                    delete[] m_begin;
+                free_raw(m_begin);
                 m_begin = previous_begin;
             }
+            trim();
             init();
         }
 
+        //! Clears the pool like clear(), but keeps the dynamic blocks
+        //! and allocates from them again, when they are large enough, before allocating more memory.
+        //! Any nodes or strings allocated from the pool will no longer be valid.
+        void recycle()
+        {
+            while (m_begin != m_static_memory)
+            {
+                header *block = reinterpret_cast<header *>(align(m_begin));
+                char *previous_begin = block->previous_begin;
+                block->previous_begin = m_spare;
+                m_spare = m_begin;
+                m_begin = previous_begin;
+            }
+            init();
+        }
+
+        //! Frees the blocks kept by recycle() that have not been allocated from again.
+        void trim()
+        {
+            while (m_spare)
+            {
+                char *next_spare = reinterpret_cast<header *>(align(m_spare))->previous_begin;
+                free_raw(m_spare);
+                m_spare = next_spare;
+            }
+        }
+
+        //! Sets the size of the dynamic blocks allocated from now on, in place of <code>RAPIDXML_DYNAMIC_POOL_SIZE</code>.
+        //! A block is still made larger when a single allocation needs more.
+        //! \param size Bytes of memory in each dynamic block.
+        void set_block_size(std::size_t size)
+        {
+            m_block_size = size ? size : RAPIDXML_DYNAMIC_POOL_SIZE;
+        }
+
+        //! Gets the bytes allocated from the pool for nodes, attributes and strings since it was last cleared.
+        //! \return Bytes allocated.
+        std::size_t allocated_size() const
+        {
+            return m_allocated_size;
+        }
+
+        //! Gets the bytes of dynamic memory holding the nodes and strings allocated from the pool,
+        //! not counting the blocks kept by recycle() that are not in use yet.
+        //! \return Bytes of dynamic memory in use.
+        std::size_t dynamic_size() const
+        {
+            return m_dynamic_size;
+        }
+
         //! Sets or resets the user-defined memory allocation functions for the pool.
         //! This can only be called when no memory is allocated from the pool yet, otherwise results are undefined.
         //! Allocation function must not return invalid pointer on failure. It should either throw,
@@ -551,7 +601,7 @@ namespace rapidxml
         //! \param ff Free function, or 0 to restore default function
         void set_allocator(alloc_func *af, free_func *ff)
         {
-            assert(m_begin == m_static_memory && m_ptr == align(m_begin));    // Verify that no memory is allocated yet
+            assert(m_begin == m_static_memory && m_ptr == align(m_begin) && !m_spare);    // Verify that no memory is allocated yet
             m_alloc_func = af;
             m_free_func = ff;
         }
@@ -561,6 +611,7 @@ namespace rapidxml
         struct header
         {
             char *previous_begin;
+            std::size_t size;
         };
 
         void init()
@@ -568,6 +619,27 @@ namespace rapidxml
             m_begin = m_static_memory;
             m_ptr = align(m_begin);
             m_end = m_static_memory + sizeof(m_static_memory);
+            m_dynamic_size = 0;
+            m_allocated_size = 0;
+        }
+
+        // Takes the smallest block kept by recycle() of at least size bytes from the spare blocks,
+        // unless it is more than twice the size, so that a small document does not take up a large block
+        char *take_spare(std::size_t size)
+        {
+            char **best = 0;
+            for (char **spare = &m_spare; *spare; spare = &reinterpret_cast<header *>(align(*spare))->previous_begin)
+            {
+                std::size_t spare_size = reinterpret_cast<header *>(align(*spare))->size;
+                if (spare_size >= size && spare_size / 2 <= size &&
+                    (!best || spare_size < reinterpret_cast<header *>(align(*best))->size))
+                    best = spare;
+            }
+            if (!best)
+                return 0;
+            char *block = *best;
+            *best = reinterpret_cast<header *>(align(block))->previous_begin;
+            return block;
         }
         
         char *align(char *ptr)
@@ -595,6 +667,14 @@ namespace rapidxml
             }
             return static_cast<char *>(memory);
         }
+
+        void free_raw(char *memory)
+        {
+            if (m_free_func)
+                m_free_func(memory);
+            else
+                delete[] memory;
+        }
         
         void *allocate_aligned(std::size_t size)
         {
@@ -605,19 +685,25 @@ namespace rapidxml
             if (result + size > m_end)
             {
                 // Calculate required pool size (may be bigger than RAPIDXML_DYNAMIC_POOL_SIZE)
-                std::size_t pool_size = RAPIDXML_DYNAMIC_POOL_SIZE;
+                std::size_t pool_size = m_block_size;
                 if (pool_size < size)
                     pool_size = size;
                 
                 // Allocate
                 std::size_t alloc_size = sizeof(header) + (2 * RAPIDXML_ALIGNMENT - 2) + pool_size;     // 2 alignments required in worst case: one for header, one for actual allocation
-                char *raw_memory = allocate_raw(alloc_size);
+                char *raw_memory = take_spare(alloc_size);     // Reuse a block kept by recycle() if one is large enough
+                if (raw_memory)
+                    alloc_size = reinterpret_cast<header *>(align(raw_memory))->size;
+                else
+                    raw_memory = allocate_raw(alloc_size);
                     
                 // Setup new pool in allocated memory
                 char *pool = align(raw_memory);
                 header *new_header = reinterpret_cast<header *>(pool);
                 new_header->previous_begin = m_begin;
+                new_header->size = alloc_size;
                 m_begin = raw_memory;
+                m_dynamic_size += alloc_size;
                 m_ptr = pool + sizeof(header);
                 m_end = raw_memory + alloc_size;
 
@@ -627,12 +713,17 @@ namespace rapidxml
 
             // Update pool and return aligned pointer
             m_ptr = result + size;
+            m_allocated_size += size;
             return result;
         }
 
         char *m_begin;                                      // Start of raw memory making up current pool
         char *m_ptr;                                        // First free byte in current pool
         char *m_end;                                        // One past last available byte in current pool
+        char *m_spare;                                      // Blocks kept by recycle(), linked through their headers
+        std::size_t m_dynamic_size;                         // Bytes of dynamic blocks in use
+        std::size_t m_allocated_size;                       // Bytes allocated from the pool
+        std::size_t m_block_size;                           // Bytes in each new dynamic block
         char m_static_memory[RAPIDXML_STATIC_POOL_SIZE];    // Static raw memory
         alloc_func *m_alloc_func;                           // Allocator function, or 0 if default is to be used
         free_func *m_free_func;                             // Free function, or 0 if default is to be used
@@ -1418,6 +1509,16 @@ namespace rapidxml
             this->remove_all_attributes();
             memory_pool<Ch>::clear();
         }
+
+        //! Clears the document like clear(), but recycles the memory pool, 
+        //! so that the next document parsed reuses its dynamic blocks.
+        //! All nodes owned by document pool are destroyed.
+        void recycle()
+        {
+            this->remove_all_nodes();
+            this->remove_all_attributes();
+            memory_pool<Ch>::recycle();
+        }
         
     private:
 
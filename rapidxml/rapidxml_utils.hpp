@@ -12,6 +12,19 @@
 #include <string>
 #include <fstream>
 #include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <atomic>
+#include <cstdint>
+#define RAPIDXML_MAPPED_FILE
+#endif
 
 namespace rapidxml
 {
@@ -87,6 +100,232 @@ namespace rapidxml
 
     };
 
+#ifdef RAPIDXML_MAPPED_FILE
+
+    //! \cond internal
+    namespace internal
+    {
+
+        // The mappings of files that are guarded against the file shrinking while they are
+        // mapped. Reading a page past the new end of the file raises SIGBUS; the handler maps a
+        // page of zeros over the faulting page instead, so the parser stops at the 0 and the
+        // mapping is marked as truncated. Faults outside these mappings go to the handler that
+        // was installed before. It must be a template because it has static data members.
+        template<int Dummy>
+        struct mapping_guard
+        {
+            static const std::size_t slots = 1024;
+            static std::atomic<std::uintptr_t> begin[slots];
+            static std::atomic<std::uintptr_t> end[slots];
+            static std::atomic<bool> faulted[slots];
+            static std::atomic<bool> installed;
+            static struct sigaction previous;
+
+            // Guards [first, last), returns the slot to release or throws when all are taken
+            static std::size_t acquire(const void *first, const void *last)
+            {
+                install();
+                for (std::size_t slot = 0; slot < slots; ++slot)
+                {
+                    std::uintptr_t free = 0;
+                    if (begin[slot].compare_exchange_strong(free, reinterpret_cast<std::uintptr_t>(first)))
+                    {
+                        faulted[slot] = false;
+                        end[slot] = reinterpret_cast<std::uintptr_t>(last);
+                        return slot;
+                    }
+                }
+                throw std::runtime_error("cannot map file: too many files mapped");
+            }
+
+            static void release(std::size_t slot)
+            {
+                end[slot] = 0;
+                begin[slot] = 0;
+            }
+
+            static void install()
+            {
+                if (installed.exchange(true))
+                    return;
+                struct sigaction action;
+                std::memset(&action, 0, sizeof(action));
+                action.sa_sigaction = &handle;
+                action.sa_flags = SA_SIGINFO | SA_RESTART;
+                sigemptyset(&action.sa_mask);
+                ::sigaction(SIGBUS, &action, &previous);
+            }
+
+            static void handle(int signal, siginfo_t *info, void *context)
+            {
+                std::uintptr_t address = reinterpret_cast<std::uintptr_t>(info->si_addr);
+                for (std::size_t slot = 0; slot < slots; ++slot)
+                {
+                    std::uintptr_t first = begin[slot];
+                    if (first == 0 || address < first || address >= end[slot])
+                        continue;
+                    std::uintptr_t page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+                    void *faulting = reinterpret_cast<void *>(address / page * page);
+                    if (::mmap(faulting, page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+                        break;
+                    faulted[slot] = true;
+                    return;
+                }
+                // Not a guarded mapping; the fault is raised again under the previous handler
+                if ((previous.sa_flags & SA_SIGINFO) && previous.sa_sigaction)
+                    return previous.sa_sigaction(signal, info, context);
+                ::sigaction(SIGBUS, &previous, 0);
+            }
+        };
+
+        template<int Dummy> std::atomic<std::uintptr_t> mapping_guard<Dummy>::begin[mapping_guard<Dummy>::slots];
+        template<int Dummy> std::atomic<std::uintptr_t> mapping_guard<Dummy>::end[mapping_guard<Dummy>::slots];
+        template<int Dummy> std::atomic<bool> mapping_guard<Dummy>::faulted[mapping_guard<Dummy>::slots];
+        template<int Dummy> std::atomic<bool> mapping_guard<Dummy>::installed;
+        template<int Dummy> struct sigaction mapping_guard<Dummy>::previous;
+
+    }
+    //! \endcond
+
+    //! Represents a file mapped into memory. The mapping is private (copy-on-write), so the
+    //! data can be parsed in situ without being read through a stream first; only the pages
+    //! the parser writes to are copied. Like file, the data is followed by a terminating 0.
+    //! When the file is truncated while it is mapped, the lost pages read as zeros instead of
+    //! raising SIGBUS, and truncated() tells that the data was cut short.
+    template<class Ch = char>
+    class mapped_file
+    {
+        
+    public:
+        
+        //! Maps file into the memory. The mapping is removed by the destructor.
+        //! \param filename Filename to map.
+        mapped_file(const char *filename)
+            : m_data(0)
+            , m_size(0)
+            , m_mapped(0)
+            , m_slot(0)
+        {
+            int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                throw std::runtime_error(std::string("cannot open file ") + filename + ": " + std::strerror(errno));
+            try
+            {
+                map(fd);
+            }
+            catch (...)
+            {
+                ::close(fd);
+                throw;
+            }
+            ::close(fd);
+        }
+
+        //! Maps an open regular file into the memory. The descriptor is not closed.
+        //! \param fd Descriptor of the file to map.
+        explicit mapped_file(int fd)
+            : m_data(0)
+            , m_size(0)
+            , m_mapped(0)
+            , m_slot(0)
+        {
+            map(fd);
+        }
+
+        ~mapped_file()
+        {
+            if (m_data)
+            {
+                internal::mapping_guard<0>::release(m_slot);
+                ::munmap(m_data, m_mapped);
+            }
+        }
+
+        //! Gets file data.
+        //! \return Pointer to data of file.
+        Ch *data()
+        {
+            return static_cast<Ch *>(m_data);
+        }
+
+        //! Gets file data.
+        //! \return Pointer to data of file.
+        const Ch *data() const
+        {
+            return static_cast<const Ch *>(m_data);
+        }
+
+        //! Gets file data size.
+        //! \return Size of file data, in characters, including the terminating 0.
+        std::size_t size() const
+        {
+            return m_size / sizeof(Ch) + 1;
+        }
+
+        //! Checks whether the file shrank while it was mapped. The pages past its new end read
+        //! as zeros rather than raising SIGBUS, so the data is cut short where they start.
+        //! \return True if a page past the end of the file was read.
+        bool truncated() const
+        {
+            return m_data && internal::mapping_guard<0>::faulted[m_slot];
+        }
+
+        //! Checks whether fd refers to a file that can be mapped.
+        static bool mappable(int fd)
+        {
+            struct stat status;
+            return ::fstat(fd, &status) == 0 && S_ISREG(status.st_mode);
+        }
+
+    private:
+
+        mapped_file(const mapped_file &);
+        mapped_file &operator =(const mapped_file &);
+
+        void map(int fd)
+        {
+            struct stat status;
+            if (::fstat(fd, &status) != 0)
+                throw std::runtime_error(std::string("cannot stat file: ") + std::strerror(errno));
+            if (!S_ISREG(status.st_mode))
+                throw std::runtime_error("cannot map a file that is not a regular file");
+            m_size = static_cast<std::size_t>(status.st_size);
+
+            // Reserve whole pages for the data and the terminating 0. The pages past the end of
+            // the file stay anonymous, so they read as zeros even when the file ends on a page
+            // boundary, where touching a mapping of the file itself would fault.
+            std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            m_mapped = (m_size + sizeof(Ch) + page - 1) / page * page;
+            void *reserved = ::mmap(0, m_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (reserved == MAP_FAILED)
+                throw std::runtime_error(std::string("cannot map file: ") + std::strerror(errno));
+            if (m_size > 0 && ::mmap(reserved, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+            {
+                int error = errno;
+                ::munmap(reserved, m_mapped);
+                throw std::runtime_error(std::string("cannot map file: ") + std::strerror(error));
+            }
+            try
+            {
+                m_slot = internal::mapping_guard<0>::acquire(reserved, static_cast<char *>(reserved) + m_size);
+            }
+            catch (...)
+            {
+                ::munmap(reserved, m_mapped);
+                throw;
+            }
+            m_data = reserved;
+        }
+
+        void *m_data;             // Start of the mapping
+        std::size_t m_size;       // File size, in bytes
+        std::size_t m_mapped;     // Mapping size, in bytes
+        std::size_t m_slot;       // Slot of the mapping in the guard against SIGBUS
+
+    };
+
+#endif
+
     //! Counts children of node. Time complexity is O(n).
     //! \return Number of children of node
     template<class Ch>
@@ -0,0 +1,157 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "redirect_cache.hpp"
+#include "fetch_queue.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+
+bool is_redirect(std::uint16_t status)
+{
+  return status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+}
+
+bool is_permanent_redirect(std::uint16_t status)
+{
+  return status == 301 || status == 308;
+}
+
+std::string resolve_reference(const std::string& base, const std::string& reference)
+{
+  if (reference.find("://") != std::string::npos &&
+      reference.find("://") < reference.find_first_of("/?#")) {
+    return reference;
+  }
+  std::string::size_type scheme = base.find("://");
+  if (scheme == std::string::npos) {
+    return reference;
+  }
+  if (reference.compare(0, 2, "//") == 0) {
+    return base.substr(0, scheme + 1) + reference;
+  }
+  std::string::size_type path = base.find_first_of("/?#", scheme + 3);
+  std::string origin = base.substr(0, path);
+  if (reference.empty()) {
+    return base.substr(0, base.find('#'));
+  }
+  if (reference[0] == '/') {
+    return origin + reference;
+  }
+  std::string basePath = path == std::string::npos ? std::string("/") : base.substr(path);
+  if (reference[0] == '?') {
+    return origin + basePath.substr(0, basePath.find_first_of("?#")) + reference;
+  }
+  basePath = basePath.substr(0, basePath.find_first_of("?#"));
+  // the dot segments are removed when the result is normalized
+  return origin + basePath.substr(0, basePath.rfind('/') + 1) + reference;
+}
+
+std::string RedirectCache::apply(const std::string& uri)
+{
+  {
+    // with no redirects known, uri need not be normalized to look it up
+    std::unique_lock<std::mutex> guard(lock);
+    if (targets.empty()) {
+      return uri;
+    }
+  }
+  std::string key = normalize_uri(uri);
+  std::unique_lock<std::mutex> guard(lock);
+  std::string current = key;
+  size_t hops = 0;
+  for (auto found = targets.find(current); found != targets.end(); found = targets.find(current)) {
+    if (++hops > max_hops || found->second == key) {
+      ++counters.loops;
+      return uri;
+    }
+    current = found->second;
+  }
+  if (hops == 0) {
+    return uri;
+  }
+  ++counters.applied;
+  return current;
+}
+
+std::string RedirectCache::redirected(const std::string& from, std::uint16_t status, const std::string& location)
+{
+  if (!is_redirect(status) || location.empty()) {
+    return std::string();
+  }
+  std::string to = normalize_uri(resolve_reference(from, location));
+  std::string key = normalize_uri(from);
+  std::unique_lock<std::mutex> guard(lock);
+  ++counters.followed;
+  if (to == key) {
+    ++counters.loops;
+    return std::string();
+  }
+  if (is_permanent_redirect(status)) {
+    auto& target = targets[key];
+    if (target != to) {
+      target = to;
+      ++counters.learned;
+    }
+  }
+  return to;
+}
+
+void RedirectCache::load(const std::string& path)
+{
+  std::ifstream file(path);
+  std::string line;
+  std::unique_lock<std::mutex> guard(lock);
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string from, to;
+    if (fields >> from >> to) {
+      targets[normalize_uri(from)] = normalize_uri(to);
+    }
+  }
+}
+
+void RedirectCache::save(const std::string& path) const
+{
+  // written aside and renamed, so a crash leaves the old map intact
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    std::unique_lock<std::mutex> guard(lock);
+    for (auto& target : targets) {
+      file << target.first << " " << target.second << "\n";
+    }
+    if (!file.flush()) {
+      throw std::runtime_error("could not write " + temporary);
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("could not replace " + path);
+  }
+}
+
+RedirectCache::Stats RedirectCache::stats() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return counters;
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___REDIRECT_CACHE_INC__
+#define ___REDIRECT_CACHE_INC__
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+// true for the 301, 302, 303, 307 and 308 statuses
+bool is_redirect(std::uint16_t status);
+
+// true for the permanent redirects, 301 and 308
+bool is_permanent_redirect(std::uint16_t status);
+
+// resolves the Location of a redirect against the uri that was requested
+std::string resolve_reference(const std::string& base, const std::string& reference);
+
+// remembers where permanent redirects lead, so that later polls of a
+// feed that has moved go straight to its new location instead of
+// paying a round trip for the redirect every time. the map can be saved
+// to a file so it outlives the process.
+class RedirectCache
+{
+public:
+  struct Stats
+  {
+    Stats() : learned(0), applied(0), followed(0), loops(0) {}
+    // permanent redirects recorded
+    size_t learned;
+    // requests sent straight to a known target, each a round trip saved
+    size_t applied;
+    // redirects followed as they were received, permanent or not
+    size_t followed;
+    // redirect chains that led back on themselves
+    size_t loops;
+  };
+
+  // the most redirects followed for one request
+  static const size_t max_hops = 5;
+
+  // the uri to request for uri, after the known permanent redirects
+  std::string apply(const std::string& uri);
+
+  // called with the response to a request for from. returns the uri to
+  // request next, or an empty string when the response is not a
+  // redirect. a permanent redirect is remembered.
+  std::string redirected(const std::string& from, std::uint16_t status, const std::string& location);
+
+  // reads "from to" lines written by save(). a missing file is empty.
+  void load(const std::string& path);
+  void save(const std::string& path) const;
+
+  Stats stats() const;
+
+private:
+  mutable std::mutex lock;
+  // keyed and valued by normalize_uri()
+  std::unordered_map<std::string, std::string> targets;
+  Stats counters;
+};
+
+#endif  // ___REDIRECT_CACHE_INC__
@@ -0,0 +1,409 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "resolver_cache.hpp"
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+
+#include <netdb.h>
+#include <strings.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+#include <resolv.h>
+
+std::string numeric_host(const sockaddr_storage& address)
+{
+  char host[NI_MAXHOST] = {};
+  socklen_t length = address.ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+  ::getnameinfo(reinterpret_cast<const sockaddr*>(&address), length, host, sizeof(host), nullptr, 0, NI_NUMERICHOST);
+  return host;
+}
+
+namespace {
+
+// parses text as an ipv4 or ipv6 address
+bool numeric_address(const std::string& text, sockaddr_storage& address)
+{
+  address = sockaddr_storage();
+  sockaddr_in& v4 = reinterpret_cast<sockaddr_in&>(address);
+  sockaddr_in6& v6 = reinterpret_cast<sockaddr_in6&>(address);
+  if (::inet_pton(AF_INET, text.c_str(), &v4.sin_addr) == 1) {
+    v4.sin_family = AF_INET;
+    return true;
+  }
+  if (::inet_pton(AF_INET6, text.c_str(), &v6.sin6_addr) == 1) {
+    v6.sin6_family = AF_INET6;
+    return true;
+  }
+  return false;
+}
+
+// the addresses /etc/hosts gives host, which take precedence over dns
+std::vector<sockaddr_storage> hosts_file(const std::string& host)
+{
+  std::vector<sockaddr_storage> result;
+  std::ifstream file("/etc/hosts");
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line.substr(0, line.find('#')));
+    std::string address;
+    std::string name;
+    if (!(fields >> address)) {
+      continue;
+    }
+    bool named = false;
+    while (!named && fields >> name) {
+      named = ::strcasecmp(name.c_str(), host.c_str()) == 0;
+    }
+    sockaddr_storage entry;
+    if (named && numeric_address(address, entry)) {
+      result.push_back(entry);
+    }
+  }
+  return result;
+}
+
+// queries dns for the A records of host, and fills in the addresses
+// and the smallest ttl of the answer, so one query gives both. returns
+// false when there is no answer to take them from, negative is set
+// when the name does not exist.
+bool query_records(const std::string& host, Resolution& result, bool& negative)
+{
+  // each thread keeps its own resolver state
+  static thread_local struct State
+  {
+    State() : ready(::res_ninit(&state) == 0) {}
+    ~State() { if (ready) ::res_nclose(&state); }
+    struct __res_state state;
+    bool ready;
+  } resolver;
+  negative = false;
+  if (!resolver.ready) {
+    return false;
+  }
+
+  unsigned char answer[4096];
+  int length = ::res_nquery(&resolver.state, host.c_str(), ns_c_in, ns_t_a, answer, sizeof(answer));
+  if (length <= 0) {
+    negative = resolver.state.res_h_errno == HOST_NOT_FOUND;
+    return false;
+  }
+  ns_msg message;
+  if (::ns_initparse(answer, length, &message) != 0) {
+    return false;
+  }
+  std::uint32_t ttl = 0;
+  bool found = false;
+  for (int cursor = 0; cursor < ns_msg_count(message, ns_s_an); ++cursor) {
+    ns_rr record;
+    if (::ns_parserr(&message, ns_s_an, cursor, &record) != 0) {
+      break;
+    }
+    // the ttl of a CNAME in the chain counts as much as the A record's
+    ttl = found ? std::min<std::uint32_t>(ttl, ns_rr_ttl(record)) : ns_rr_ttl(record);
+    found = true;
+    if (ns_rr_type(record) == ns_t_a && ns_rr_rdlen(record) == sizeof(in_addr)) {
+      sockaddr_storage address = {};
+      sockaddr_in& v4 = reinterpret_cast<sockaddr_in&>(address);
+      v4.sin_family = AF_INET;
+      std::memcpy(&v4.sin_addr, ns_rr_rdata(record), sizeof(in_addr));
+      result.addresses.push_back(address);
+    }
+  }
+  result.ttl = std::chrono::seconds(ttl);
+  return !result.addresses.empty();
+}
+
+}
+
+Resolution system_lookup(const std::string& host)
+{
+  Resolution result;
+  sockaddr_storage numeric;
+  if (numeric_address(host, numeric)) {
+    result.addresses.push_back(numeric);
+    return result;
+  }
+  result.addresses = hosts_file(host);
+  if (!result.addresses.empty()) {
+    return result;
+  }
+  bool negative = false;
+  if (query_records(host, result, negative)) {
+    return result;
+  }
+  if (negative) {
+    result.error = "resolve " + host + ": " + ::gai_strerror(EAI_NONAME);
+    result.negative = true;
+    return result;
+  }
+
+  // no A records, e.g. an ipv6 only host or one of another name service
+  result = Resolution();
+  addrinfo hints = {};
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_ADDRCONFIG;
+  addrinfo* found = nullptr;
+  int error = ::getaddrinfo(host.c_str(), nullptr, &hints, &found);
+  if (error != 0) {
+    result.error = "resolve " + host + ": " + ::gai_strerror(error);
+    result.negative = error == EAI_NONAME
+#if defined(EAI_NODATA)
+      || error == EAI_NODATA
+#endif
+      ;
+    return result;
+  }
+  for (addrinfo* cursor = found; cursor; cursor = cursor->ai_next) {
+    sockaddr_storage address = {};
+    std::memcpy(&address, cursor->ai_addr, cursor->ai_addrlen);
+    result.addresses.push_back(address);
+  }
+  ::freeaddrinfo(found);
+  return result;
+}
+
+struct ResolverCache::Shared
+{
+  typedef std::chrono::steady_clock clock;
+
+  Shared(ResolverPolicy p, Lookup l)
+    : policy(p)
+    , lookup(std::move(l))
+    , workers(0)
+    , stopping(false)
+  {}
+
+  // the host names with an answer, by when it expires
+  typedef std::multimap<clock::time_point, std::string> Expiring;
+
+  struct Entry
+  {
+    Entry() : pending(true) {}
+    Resolution answer;
+    clock::time_point expires;
+    // a lookup is running or queued, waiting holds the requests for it
+    bool pending;
+    std::vector<Resolved> waiting;
+    // in expiring while the entry has an answer, i.e. is not pending
+    Expiring::iterator position;
+  };
+
+  ResolverPolicy policy;
+  Lookup lookup;
+
+  mutable std::mutex lock;
+  std::condition_variable wake;
+  std::unordered_map<std::string, Entry> entries;
+  Expiring expiring;
+  std::deque<std::string> queue;
+  size_t workers;
+  bool stopping;
+  Stats counters;
+
+  static std::string key(const std::string& host)
+  {
+    std::string result = host;
+    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+    return result;
+  }
+
+  clock::time_point expiry(const Resolution& answer, clock::time_point now) const
+  {
+    std::chrono::seconds ttl = answer.ttl;
+    if (answer.negative) {
+      ttl = policy.negative_ttl;
+    } else if (ttl == std::chrono::seconds(0)) {
+      ttl = policy.default_ttl;
+    }
+    return now + std::max(policy.min_ttl, std::min(policy.max_ttl, ttl));
+  }
+
+  // drops the answers expiring soonest, expired or not, until there are
+  // no more entries than max_entries. entries waiting for a lookup stay.
+  // must hold lock.
+  void prune()
+  {
+    while (entries.size() > policy.max_entries && !expiring.empty()) {
+      entries.erase(expiring.begin()->second);
+      expiring.erase(expiring.begin());
+    }
+  }
+
+  static void worker(std::shared_ptr<Shared> that)
+  {
+    std::unique_lock<std::mutex> guard(that->lock);
+    for (;;) {
+      if (that->stopping) {
+        break;
+      }
+      if (that->queue.empty()) {
+        that->wake.wait(guard);
+        continue;
+      }
+      std::string host = std::move(that->queue.front());
+      that->queue.pop_front();
+
+      guard.unlock();
+      auto start = clock::now();
+      Resolution answer;
+      try {
+        answer = that->lookup(host);
+      } catch (const std::exception& e) {
+        answer.error = "resolve " + host + ": " + e.what();
+      }
+      auto now = clock::now();
+      guard.lock();
+
+      ++that->counters.lookups;
+      that->counters.lookup_time += now - start;
+      that->counters.slowest = std::max(that->counters.slowest, now - start);
+      if (!answer.error.empty() && !answer.negative) {
+        ++that->counters.failures;
+      }
+
+      auto found = that->entries.find(host);
+      if (found == that->entries.end()) {
+        continue;
+      }
+      std::vector<Resolved> waiting;
+      waiting.swap(found->second.waiting);
+      if (!answer.error.empty() && !answer.negative) {
+        // a timeout or a server failure, the next request tries again
+        that->entries.erase(found);
+      } else {
+        found->second.pending = false;
+        found->second.expires = that->expiry(answer, now);
+        found->second.answer = answer;
+        found->second.position = that->expiring.insert(std::make_pair(found->second.expires, host));
+      }
+      that->prune();
+
+      guard.unlock();
+      for (auto& resolved : waiting) {
+        resolved(answer);
+      }
+      guard.lock();
+    }
+
+    if (--that->workers == 0) {
+      // fail the requests that are still waiting and release the
+      // callbacks, which may hold the owner of this cache alive.
+      std::vector<Resolved> waiting;
+      for (auto& entry : that->entries) {
+        for (auto& resolved : entry.second.waiting) {
+          waiting.push_back(std::move(resolved));
+        }
+      }
+      that->entries.clear();
+      that->expiring.clear();
+      that->queue.clear();
+      that->lookup = nullptr;
+      guard.unlock();
+      Resolution canceled;
+      canceled.error = "resolve: canceled";
+      for (auto& resolved : waiting) {
+        resolved(canceled);
+      }
+    }
+  }
+};
+
+ResolverCache::ResolverCache(ResolverPolicy policy, Lookup lookup)
+  : shared(std::make_shared<Shared>(policy, std::move(lookup)))
+{
+  size_t count = std::max<size_t>(1, policy.workers);
+  shared->workers = count;
+  for (size_t cursor = 0; cursor < count; ++cursor) {
+    // workers own a reference to the shared state, so a slow lookup
+    // does not hold up the destruction of this cache.
+    std::thread(&Shared::worker, shared).detach();
+  }
+}
+
+ResolverCache::~ResolverCache()
+{
+  std::unique_lock<std::mutex> guard(shared->lock);
+  shared->stopping = true;
+  shared->wake.notify_all();
+}
+
+void ResolverCache::resolve(const std::string& host, Resolved resolved)
+{
+  std::string key = Shared::key(host);
+  auto now = Shared::clock::now();
+  std::unique_lock<std::mutex> guard(shared->lock);
+  if (shared->stopping) {
+    guard.unlock();
+    Resolution canceled;
+    canceled.error = "resolve: canceled";
+    resolved(canceled);
+    return;
+  }
+  Shared::Entry& entry = shared->entries[key];
+  if (!entry.pending && entry.expires > now) {
+    Resolution answer = entry.answer;
+    ++(answer.negative ? shared->counters.negative_hits : shared->counters.hits);
+    guard.unlock();
+    resolved(answer);
+    return;
+  }
+  ++shared->counters.misses;
+  if (entry.pending && !entry.waiting.empty()) {
+    ++shared->counters.coalesced;
+  } else {
+    if (!entry.pending) {
+      // expired, looked up again
+      shared->expiring.erase(entry.position);
+    }
+    entry.pending = true;
+    shared->queue.push_back(key);
+    shared->wake.notify_one();
+  }
+  entry.waiting.push_back(std::move(resolved));
+}
+
+Resolution ResolverCache::resolve(const std::string& host)
+{
+  auto answer = std::make_shared<std::promise<Resolution>>();
+  resolve(host, Resolved([=](const Resolution& resolution){
+    answer->set_value(resolution);}));
+  return answer->get_future().get();
+}
+
+ResolverCache::Stats ResolverCache::stats() const
+{
+  std::unique_lock<std::mutex> guard(shared->lock);
+  return shared->counters;
+}
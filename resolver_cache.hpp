@@ -0,0 +1,133 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___RESOLVER_CACHE_INC__
+#define ___RESOLVER_CACHE_INC__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <sys/socket.h>
+
+struct ResolverPolicy
+{
+  ResolverPolicy()
+    : workers(4)
+    , min_ttl(std::chrono::seconds(5))
+    , max_ttl(std::chrono::hours(1))
+    , default_ttl(std::chrono::minutes(5))
+    , negative_ttl(std::chrono::seconds(30))
+    , max_entries(10000)
+  {}
+  // threads running lookups, and so the most lookups at once
+  size_t workers;
+  // bounds on the record ttl, so a ttl of 0 does not defeat the cache
+  // and a long one does not pin a stale address
+  std::chrono::seconds min_ttl;
+  std::chrono::seconds max_ttl;
+  // used when the lookup could not tell the ttl, e.g. a hosts file entry
+  std::chrono::seconds default_ttl;
+  // how long a name that does not exist is remembered
+  std::chrono::seconds negative_ttl;
+  // the answers expiring soonest are dropped, expired or not, once the
+  // cache grows past this
+  size_t max_entries;
+};
+
+// the answer for one host name
+struct Resolution
+{
+  Resolution() : ttl(0), negative(false) {}
+  std::vector<sockaddr_storage> addresses;
+  // the smallest ttl of the records, zero when unknown
+  std::chrono::seconds ttl;
+  // empty when addresses were found
+  std::string error;
+  // the name does not exist, which is cached like an answer. other
+  // errors are not cached.
+  bool negative;
+};
+
+// the numeric form of address, e.g. "192.0.2.1" or "2001:db8::1"
+std::string numeric_host(const sockaddr_storage& address);
+
+// resolves host from the hosts file, or else with one DNS query for its
+// A records, which gives the addresses and their ttl together. a host
+// with no A records, e.g. one with only ipv6 addresses or one known to
+// another name service, is resolved with getaddrinfo, without a ttl.
+Resolution system_lookup(const std::string& host);
+
+// resolves host names on a few worker threads and caches the answers,
+// positive and negative, for the ttl of their records. concurrent
+// requests for a name that is being looked up wait for that lookup.
+class ResolverCache
+{
+public:
+  typedef std::function<Resolution(const std::string&)> Lookup;
+  typedef std::function<void(const Resolution&)> Resolved;
+
+  struct Stats
+  {
+    Stats()
+      : hits(0), negative_hits(0), misses(0), coalesced(0), failures(0)
+      , lookups(0), lookup_time(0), slowest(0)
+    {}
+    // answered from the cache, with addresses or that the name does not exist
+    size_t hits;
+    size_t negative_hits;
+    // requests that had to wait for a lookup
+    size_t misses;
+    // of the misses, those that joined a lookup already running
+    size_t coalesced;
+    // lookups that failed for a reason other than a missing name
+    size_t failures;
+    size_t lookups;
+    std::chrono::steady_clock::duration lookup_time;
+    std::chrono::steady_clock::duration slowest;
+  };
+
+  explicit ResolverCache(ResolverPolicy policy = ResolverPolicy(), Lookup lookup = system_lookup);
+
+  // requests still waiting for a lookup are resolved with an error
+  ~ResolverCache();
+
+  // calls resolved with the answer for host, right away from the cache
+  // or later on a worker thread.
+  void resolve(const std::string& host, Resolved resolved);
+
+  // waits for the answer for host
+  Resolution resolve(const std::string& host);
+
+  Stats stats() const;
+
+private:
+  ResolverCache(const ResolverCache&);
+  ResolverCache& operator=(const ResolverCache&);
+
+  struct Shared;
+  std::shared_ptr<Shared> shared;
+};
+
+#endif  // ___RESOLVER_CACHE_INC__
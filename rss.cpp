@@ -16,6 +16,10 @@ channel::channel(const std::shared_ptr<rapidxml::xml_document<>>& doc) {
     parse(*doc.get());
 }
 
+channel::channel(rapidxml::xml_document<>& doc) {
+  parse(doc);
+}
+
 channel::channel(const http::client::response& response) {
   std::string response_body = body(response);
   rapidxml::xml_document<> doc;
@@ -55,6 +59,21 @@ void channel::parse(rapidxml::xml_document<>& doc) {
     author_ = author->first_node()->value();
   }
 
+  rapidxml::xml_node<>* ttl = channel->first_node("ttl");
+  if (ttl) {
+    ttl_ = ttl->value();
+  }
+
+  rapidxml::xml_node<>* update_period = channel->first_node("sy:updatePeriod");
+  if (update_period) {
+    update_period_ = update_period->value();
+  }
+
+  rapidxml::xml_node<>* update_frequency = channel->first_node("sy:updateFrequency");
+  if (update_frequency) {
+    update_frequency_ = update_frequency->value();
+  }
+
   rapidxml::xml_node<>* item = channel->first_node("item");
   while (item) {
     items_.push_back(rss::item());
@@ -74,6 +93,16 @@ void channel::parse(rapidxml::xml_document<>& doc) {
       items_.back().set_description(description->first_node()->value());
     }
 
+    rapidxml::xml_node<>* link = item->first_node("link");
+    if (link && link->first_node()) {
+      items_.back().set_link(link->first_node()->value());
+    }
+
+    rapidxml::xml_node<>* guid = item->first_node("guid");
+    if (guid && guid->first_node()) {
+      items_.back().set_guid(guid->first_node()->value());
+    }
+
     item = item->next_sibling();
   }
 }
@@ -34,11 +34,21 @@ class item {
 
   std::string description() const { return description_; }
 
+  void set_link(const std::string& link) { link_ = link; }
+
+  std::string link() const { return link_; }
+
+  void set_guid(const std::string& guid) { guid_ = guid; }
+
+  std::string guid() const { return guid_; }
+
  private:
 
   std::string title_;
   std::string author_;
   std::string description_;
+  std::string link_;
+  std::string guid_;
 
 };
 
@@ -51,6 +61,7 @@ class channel {
 
   channel(const http::client::response& response);
   channel(const std::shared_ptr<rapidxml::xml_document<>>& doc);
+  explicit channel(rapidxml::xml_document<>& doc);
 
   std::string title() const { return title_; }
 
@@ -60,6 +71,12 @@ class channel {
 
   std::string author() const { return author_; }
 
+  std::string ttl() const { return ttl_; }
+
+  std::string update_period() const { return update_period_; }
+
+  std::string update_frequency() const { return update_frequency_; }
+
   size_t item_count() const { return items_.size(); }
 
   iterator begin() { return items_.begin(); }
@@ -77,6 +94,9 @@ class channel {
   std::string description_;
   std::string link_;
   std::string author_;
+  std::string ttl_;
+  std::string update_period_;
+  std::string update_frequency_;
   std::vector<item> items_;
 
 };
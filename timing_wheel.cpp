@@ -0,0 +1,194 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "timing_wheel.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+const std::uint32_t TimingWheel::invalid;
+const unsigned TimingWheel::slot_bits;
+const std::uint32_t TimingWheel::slots;
+const TimingWheel::tick_type TimingWheel::slot_mask;
+const unsigned TimingWheel::levels;
+const std::uint32_t TimingWheel::expiring_list;
+const std::uint32_t TimingWheel::free_list;
+
+TimingWheel::TimingWheel(tick_type now)
+  : current(now)
+  , count(0)
+  , heads(free_list + 1, invalid)
+{
+}
+
+// a timer lives at the finest level whose coarser bits match now(),
+// in the slot picked by its deadline's bits for that level.
+std::uint32_t TimingWheel::place(tick_type deadline) const
+{
+  for (unsigned level = 0; level < levels; ++level) {
+    unsigned shift = slot_bits * (level + 1);
+    if (level + 1 == levels || (deadline >> shift) == (current >> shift)) {
+      return level * slots + static_cast<std::uint32_t>((deadline >> (slot_bits * level)) & slot_mask);
+    }
+  }
+  return 0;
+}
+
+TimingWheel::Timer TimingWheel::insert(tick_type deadline, value_type value)
+{
+  const unsigned range_bits = slot_bits * levels;
+  if (deadline <= current) {
+    deadline = current + 1;
+  } else if (range_bits < 64 && deadline - current >= (tick_type(1) << range_bits) - slots) {
+    deadline = current + (tick_type(1) << range_bits) - slots;
+  }
+
+  std::uint32_t index = heads[free_list];
+  if (index == invalid) {
+    if (nodes.size() >= invalid) {
+      throw std::length_error("too many timers");
+    }
+    index = static_cast<std::uint32_t>(nodes.size());
+    Node node = Node();
+    node.list = invalid;
+    nodes.push_back(node);
+  } else {
+    unlink(index);
+  }
+
+  Node& node = nodes[index];
+  node.deadline = deadline;
+  node.value = value;
+  link(place(deadline), index);
+  ++count;
+
+  Timer timer;
+  timer.index = index;
+  timer.generation = node.generation;
+  return timer;
+}
+
+bool TimingWheel::cancel(Timer& timer)
+{
+  bool live = timer.valid() &&
+    timer.index < nodes.size() &&
+    nodes[timer.index].generation == timer.generation &&
+    nodes[timer.index].list != free_list;
+  if (live) {
+    unlink(timer.index);
+    release(timer.index);
+  }
+  timer = Timer();
+  return live;
+}
+
+TimingWheel::tick_type TimingWheel::next_deadline() const
+{
+  if (count == 0) {
+    return current;
+  }
+  // a timer at a level below the top has a deadline digit for that level
+  // past the one of now(), and every timer at a finer level is due
+  // before it, so the first slot in use from now() on holds the earliest.
+  for (unsigned level = 0; level < levels; ++level) {
+    bool top = level + 1 == levels;
+    std::uint32_t digit = static_cast<std::uint32_t>((current >> (slot_bits * level)) & slot_mask);
+    tick_type earliest = ~tick_type(0);
+    for (std::uint32_t slot = top ? 0 : digit + 1; slot < slots; ++slot) {
+      for (std::uint32_t index = heads[level * slots + slot]; index != invalid; index = nodes[index].next) {
+        earliest = std::min(earliest, nodes[index].deadline);
+      }
+      // the top level may wrap around, all of its slots are visited
+      if (!top && earliest != ~tick_type(0)) {
+        break;
+      }
+    }
+    if (earliest != ~tick_type(0)) {
+      return earliest;
+    }
+  }
+  return current;
+}
+
+void TimingWheel::cascade()
+{
+  // find the coarsest level whose slot boundary was just crossed, then
+  // redistribute from there down so each finer slot is emptied before
+  // timers from coarser slots land in it.
+  unsigned top = 0;
+  for (unsigned level = 1; level < levels; ++level) {
+    if ((current & ((tick_type(1) << (slot_bits * level)) - 1)) != 0) {
+      break;
+    }
+    top = level;
+  }
+  for (unsigned level = top; level > 0; --level) {
+    std::uint32_t slot = level * slots + static_cast<std::uint32_t>((current >> (slot_bits * level)) & slot_mask);
+    while (heads[slot] != invalid) {
+      std::uint32_t index = heads[slot];
+      unlink(index);
+      link(place(nodes[index].deadline), index);
+    }
+  }
+}
+
+void TimingWheel::link(std::uint32_t list, std::uint32_t index)
+{
+  Node& node = nodes[index];
+  node.list = list;
+  node.prev = invalid;
+  node.next = heads[list];
+  if (node.next != invalid) {
+    nodes[node.next].prev = index;
+  }
+  heads[list] = index;
+}
+
+void TimingWheel::unlink(std::uint32_t index)
+{
+  Node& node = nodes[index];
+  if (node.prev != invalid) {
+    nodes[node.prev].next = node.next;
+  } else {
+    heads[node.list] = node.next;
+  }
+  if (node.next != invalid) {
+    nodes[node.next].prev = node.prev;
+  }
+  node.prev = node.next = invalid;
+  node.list = invalid;
+}
+
+void TimingWheel::move(std::uint32_t from, std::uint32_t to)
+{
+  while (heads[from] != invalid) {
+    std::uint32_t index = heads[from];
+    unlink(index);
+    link(to, index);
+  }
+}
+
+void TimingWheel::release(std::uint32_t index)
+{
+  ++nodes[index].generation;
+  link(free_list, index);
+  --count;
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___TIMING_WHEEL_INC__
+#define ___TIMING_WHEEL_INC__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// a hierarchical timing wheel. deadlines are in ticks. insert, cancel
+// and the expiry of each timer are O(1); advancing costs O(1) per tick
+// plus the occasional cascade of a slot from a coarser level into a
+// finer one, which moves each timer at most once per level.
+//
+// levels * slot_bits bits of ticks are covered, later deadlines are
+// clamped to the end of the range.
+class TimingWheel
+{
+public:
+  typedef std::uint64_t tick_type;
+  typedef std::uint32_t value_type;
+
+  struct Timer
+  {
+    Timer() : index(invalid), generation(0) {}
+    bool valid() const { return index != invalid; }
+    std::uint32_t index;
+    std::uint32_t generation;
+  };
+
+  explicit TimingWheel(tick_type now = 0);
+
+  tick_type now() const { return current; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  // value expires at the first advance() to reach deadline. deadlines at
+  // or before now() expire on the next tick.
+  Timer insert(tick_type deadline, value_type value);
+
+  // returns false if timer already expired or was cancelled
+  bool cancel(Timer& timer);
+
+  // the earliest deadline of the timers, or now() when there are none.
+  // visits the slots of each level in order up to the first one in use,
+  // and the timers of that slot.
+  tick_type next_deadline() const;
+
+  // moves now() forward to to, calling expired(value) for each timer
+  // that expires on the way. expired may insert and cancel timers.
+  template<class Expired>
+  void advance(tick_type to, Expired&& expired)
+  {
+    while (current < to) {
+      ++current;
+      cascade();
+      std::uint32_t slot = static_cast<std::uint32_t>(current & slot_mask);
+      move(slot, expiring_list);
+      while (heads[expiring_list] != invalid) {
+        std::uint32_t index = heads[expiring_list];
+        value_type value = nodes[index].value;
+        unlink(index);
+        release(index);
+        expired(value);
+      }
+    }
+  }
+
+private:
+  static const std::uint32_t invalid = 0xffffffff;
+  static const unsigned slot_bits = 8;
+  static const std::uint32_t slots = 1 << slot_bits;
+  static const tick_type slot_mask = slots - 1;
+  static const unsigned levels = 5;
+  static const std::uint32_t expiring_list = levels * slots;
+  static const std::uint32_t free_list = expiring_list + 1;
+
+  struct Node
+  {
+    tick_type deadline;
+    value_type value;
+    std::uint32_t generation;
+    std::uint32_t list;
+    std::uint32_t prev;
+    std::uint32_t next;
+  };
+
+  std::uint32_t place(tick_type deadline) const;
+  void cascade();
+  void link(std::uint32_t list, std::uint32_t index);
+  void unlink(std::uint32_t index);
+  void move(std::uint32_t from, std::uint32_t to);
+  void release(std::uint32_t index);
+
+  tick_type current;
+  size_t count;
+  std::vector<Node> nodes;
+  // list heads, one per slot of each level then the expiring and free lists
+  std::vector<std::uint32_t> heads;
+};
+
+#endif  // ___TIMING_WHEEL_INC__
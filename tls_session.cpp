@@ -0,0 +1,275 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "tls_session.hpp"
+#include <stdexcept>
+#include <ctime>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#include <arpa/inet.h>
+
+namespace {
+
+std::chrono::nanoseconds thread_cpu()
+{
+  timespec now;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+}
+
+std::string last_error()
+{
+  unsigned long code = ERR_get_error();
+  ERR_clear_error();
+  if (code == 0) {
+    return "unknown error";
+  }
+  char text[256];
+  ERR_error_string_n(code, text, sizeof(text));
+  return text;
+}
+
+bool is_address(const std::string& host)
+{
+  unsigned char address[16];
+  return ::inet_pton(AF_INET, host.c_str(), address) == 1 || ::inet_pton(AF_INET6, host.c_str(), address) == 1;
+}
+
+}
+
+TlsContext::TlsContext(TlsPolicy p)
+  : policy(std::move(p))
+  , context(SSL_CTX_new(TLS_client_method()))
+{
+  if (!context) {
+    throw std::runtime_error("tls: " + last_error());
+  }
+  SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+  // sessions are kept here per host rather than in openssl's own cache,
+  // which is keyed by session id and so of no use to a client
+  SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(context, &TlsContext::on_new_session);
+  if (policy.verify_peer) {
+    SSL_CTX_set_verify(context, SSL_VERIFY_PEER, nullptr);
+    SSL_CTX_set_default_verify_paths(context);
+    if (!policy.ca_file.empty() &&
+        SSL_CTX_load_verify_locations(context, policy.ca_file.c_str(), nullptr) != 1) {
+      std::string error = last_error();
+      SSL_CTX_free(context);
+      throw std::runtime_error("tls: loading " + policy.ca_file + ": " + error);
+    }
+  }
+}
+
+TlsContext::~TlsContext()
+{
+  for (auto& session : sessions) {
+    SSL_SESSION_free(session.second);
+  }
+  SSL_CTX_free(context);
+}
+
+int TlsContext::on_new_session(SSL* ssl, SSL_SESSION* session)
+{
+  auto that = static_cast<TlsSession*>(SSL_get_app_data(ssl));
+  if (!that || !SSL_SESSION_is_resumable(session)) {
+    return 0;
+  }
+  that->context->store(that->key, session);
+  // the reference is kept
+  return 1;
+}
+
+SSL_SESSION* TlsContext::session(const std::string& key)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto found = sessions.find(key);
+  if (found == sessions.end()) {
+    return nullptr;
+  }
+  SSL_SESSION_up_ref(found->second);
+  return found->second;
+}
+
+void TlsContext::store(const std::string& key, SSL_SESSION* session)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto& stored = sessions[key];
+  if (stored) {
+    SSL_SESSION_free(stored);
+  }
+  stored = session;
+}
+
+void TlsContext::forget(const std::string& key)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto found = sessions.find(key);
+  if (found != sessions.end()) {
+    SSL_SESSION_free(found->second);
+    sessions.erase(found);
+  }
+}
+
+void TlsContext::handshaken(bool resumed, std::chrono::nanoseconds cpu)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  if (resumed) {
+    ++counters.resumed;
+    counters.resumed_cpu += cpu;
+  } else {
+    ++counters.full;
+    counters.full_cpu += cpu;
+  }
+}
+
+void TlsContext::handshake_failed(const std::string& key)
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    ++counters.failed;
+  }
+  // the session may be why, the next connection starts afresh
+  forget(key);
+}
+
+TlsContext::Stats TlsContext::stats() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return counters;
+}
+
+TlsSession::TlsSession(std::shared_ptr<TlsContext> c, const std::string& h, const std::string& k)
+  : context(std::move(c))
+  , host(h)
+  , key(k)
+  , ssl(SSL_new(context->context))
+  , incoming(nullptr)
+  , outgoing(nullptr)
+  , done(false)
+  , cpu(0)
+{
+  if (!ssl) {
+    throw std::runtime_error("tls: " + last_error());
+  }
+  incoming = BIO_new(BIO_s_mem());
+  outgoing = BIO_new(BIO_s_mem());
+  // the ssl owns the bios from here
+  SSL_set_bio(ssl, incoming, outgoing);
+  SSL_set_app_data(ssl, this);
+  SSL_set_connect_state(ssl);
+  if (!is_address(host)) {
+    SSL_set_tlsext_host_name(ssl, host.c_str());
+  }
+  if (context->policy.verify_peer) {
+    SSL_set_hostflags(ssl, X509_CHECK_FLAG_NO_PARTIAL_WILDCARDS);
+    SSL_set1_host(ssl, host.c_str());
+  }
+  SSL_SESSION* session = context->session(key);
+  if (session) {
+    SSL_set_session(ssl, session);
+    SSL_SESSION_free(session);
+  }
+}
+
+TlsSession::~TlsSession()
+{
+  if (done) {
+    // servers often close feeds without a close_notify. without this
+    // SSL_free takes that as a broken session and spoils it for reuse.
+    SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+  }
+  SSL_free(ssl);
+}
+
+bool TlsSession::handshake()
+{
+  if (done) {
+    return true;
+  }
+  auto start = thread_cpu();
+  int result = SSL_do_handshake(ssl);
+  cpu += thread_cpu() - start;
+  if (result == 1) {
+    done = true;
+    context->handshaken(resumed(), cpu);
+    return true;
+  }
+  int error = SSL_get_error(ssl, result);
+  if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+    return false;
+  }
+  std::string reason = last_error();
+  long verified = SSL_get_verify_result(ssl);
+  if (verified != X509_V_OK) {
+    reason = X509_verify_cert_error_string(verified);
+  }
+  context->handshake_failed(key);
+  throw std::runtime_error("tls handshake with " + host + ": " + reason);
+}
+
+void TlsSession::received(const char* data, size_t size)
+{
+  BIO_write(incoming, data, static_cast<int>(size));
+}
+
+void TlsSession::write(const char* data, size_t size)
+{
+  // a memory bio takes all of it
+  if (size > 0 && SSL_write(ssl, data, static_cast<int>(size)) <= 0) {
+    throw std::runtime_error("tls write to " + host + ": " + last_error());
+  }
+}
+
+int TlsSession::read(char* data, size_t size)
+{
+  int result = SSL_read(ssl, data, static_cast<int>(size));
+  if (result > 0) {
+    return result;
+  }
+  int error = SSL_get_error(ssl, result);
+  if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+    return 0;
+  }
+  if (error == SSL_ERROR_ZERO_RETURN) {
+    return -1;
+  }
+  throw std::runtime_error("tls read from " + host + ": " + last_error());
+}
+
+void TlsSession::take_output(std::string& out)
+{
+  char chunk[16 * 1024];
+  for (int pending = BIO_pending(outgoing); pending > 0; pending = BIO_pending(outgoing)) {
+    int taken = BIO_read(outgoing, chunk, std::min<int>(pending, sizeof(chunk)));
+    if (taken <= 0) {
+      break;
+    }
+    out.append(chunk, taken);
+  }
+}
+
+bool TlsSession::resumed() const
+{
+  return SSL_session_reused(ssl) == 1;
+}
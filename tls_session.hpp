@@ -0,0 +1,140 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___TLS_SESSION_INC__
+#define ___TLS_SESSION_INC__
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+
+struct ssl_st;
+struct ssl_ctx_st;
+struct ssl_session_st;
+struct bio_st;
+
+struct TlsPolicy
+{
+  TlsPolicy() : verify_peer(true) {}
+  // check the certificate chain and that it names the host
+  bool verify_peer;
+  // PEM certificates trusted besides the system's, e.g. a test server's
+  std::string ca_file;
+};
+
+// the SSL_CTX shared by every https connection, with a client session
+// cache keyed by scheme://host:port. a connection to a host that was
+// seen before offers the last session or ticket the host issued, and
+// the server can resume it with an abbreviated handshake.
+class TlsContext
+{
+public:
+  struct Stats
+  {
+    Stats()
+      : full(0), resumed(0), failed(0)
+      , full_cpu(0), resumed_cpu(0)
+    {}
+    size_t full;
+    size_t resumed;
+    size_t failed;
+    // thread cpu time spent in the handshakes of each kind
+    std::chrono::nanoseconds full_cpu;
+    std::chrono::nanoseconds resumed_cpu;
+  };
+
+  explicit TlsContext(TlsPolicy policy = TlsPolicy());
+  ~TlsContext();
+
+  Stats stats() const;
+
+private:
+  TlsContext(const TlsContext&);
+  TlsContext& operator=(const TlsContext&);
+
+  friend class TlsSession;
+  static int on_new_session(ssl_st* ssl, ssl_session_st* session);
+
+  // returns a new reference to the session for key, or null
+  ssl_session_st* session(const std::string& key);
+  // takes the reference to session
+  void store(const std::string& key, ssl_session_st* session);
+  void forget(const std::string& key);
+  void handshaken(bool resumed, std::chrono::nanoseconds cpu);
+  void handshake_failed(const std::string& key);
+
+  TlsPolicy policy;
+  ssl_ctx_st* context;
+  mutable std::mutex lock;
+  std::map<std::string, ssl_session_st*> sessions;
+  Stats counters;
+};
+
+// the TLS state of one client connection. ciphertext is passed in and
+// out through memory buffers, so the caller does the socket io on its
+// own terms. failures are thrown as std::runtime_error.
+class TlsSession
+{
+public:
+  // host is the name sent in SNI and checked against the certificate,
+  // key is the session cache key
+  TlsSession(std::shared_ptr<TlsContext> context, const std::string& host, const std::string& key);
+  ~TlsSession();
+
+  // continues the handshake, returns true once it is complete
+  bool handshake();
+
+  // ciphertext received from the peer
+  void received(const char* data, size_t size);
+
+  // plaintext to be sent once the handshake is complete
+  void write(const char* data, size_t size);
+
+  // plaintext received. returns 0 when more ciphertext is needed and
+  // -1 at the end of the stream.
+  int read(char* data, size_t size);
+
+  // appends the ciphertext waiting to be sent to out
+  void take_output(std::string& out);
+
+  bool established() const { return done; }
+  bool resumed() const;
+
+private:
+  TlsSession(const TlsSession&);
+  TlsSession& operator=(const TlsSession&);
+
+  friend class TlsContext;
+  std::shared_ptr<TlsContext> context;
+  std::string host;
+  std::string key;
+  ssl_st* ssl;
+  bio_st* incoming;
+  bio_st* outgoing;
+  bool done;
+  std::chrono::nanoseconds cpu;
+};
+
+#endif  // ___TLS_SESSION_INC__
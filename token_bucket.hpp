@@ -0,0 +1,96 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___TOKEN_BUCKET_INC__
+#define ___TOKEN_BUCKET_INC__
+
+#include <chrono>
+#include <algorithm>
+
+// allows rate requests per second on average and bursts of up to burst
+// requests. a rate of zero or less is unlimited.
+class TokenBucket
+{
+public:
+  typedef std::chrono::steady_clock clock;
+
+  TokenBucket() : rate(0), burst(1), tokens(1) {}
+
+  TokenBucket(double r, double b, clock::time_point now)
+    : rate(r)
+    , burst(std::max(b, 1.0))
+    , tokens(burst)
+    , last(now)
+  {}
+
+  bool limited() const { return rate > 0; }
+
+  // true when a token can be taken at now
+  bool ready(clock::time_point now)
+  {
+    refill(now);
+    return !limited() || tokens >= 1.0;
+  }
+
+  void take(clock::time_point now)
+  {
+    refill(now);
+    if (limited()) {
+      tokens -= 1.0;
+    }
+  }
+
+  // when the next token will be available
+  clock::time_point ready_at(clock::time_point now)
+  {
+    refill(now);
+    if (!limited() || tokens >= 1.0) {
+      return now;
+    }
+    return now + std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>((1.0 - tokens) / rate));
+  }
+
+  // a full bucket is indistinguishable from a new one
+  bool full(clock::time_point now)
+  {
+    refill(now);
+    return tokens >= burst;
+  }
+
+private:
+  void refill(clock::time_point now)
+  {
+    if (limited() && now > last) {
+      tokens = std::min(burst, tokens + std::chrono::duration<double>(now - last).count() * rate);
+    }
+    last = std::max(last, now);
+  }
+
+  double rate;
+  double burst;
+  double tokens;
+  clock::time_point last;
+};
+
+#endif  // ___TOKEN_BUCKET_INC__
@@ -0,0 +1,184 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "uri_table.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+const UriTable::id_type UriTable::npos;
+const UriTable::id_type UriTable::empty_slot;
+const UriTable::id_type UriTable::erased_slot;
+const std::uint32_t UriTable::erased;
+
+UriTable::UriTable()
+  : live(0)
+  , used_slots(0)
+  , erased_bytes(0)
+{
+}
+
+std::uint32_t UriTable::hash(const char* uri, size_t size)
+{
+  // fnv-1a
+  std::uint32_t result = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    result ^= static_cast<unsigned char>(uri[i]);
+    result *= 16777619u;
+  }
+  return result;
+}
+
+// returns the slot holding uri, or else the empty slot the probe ended at
+size_t UriTable::slot(const char* uri, size_t size, std::uint32_t hashed) const
+{
+  size_t mask = slots.size() - 1;
+  for (size_t index = hashed & mask;; index = (index + 1) & mask) {
+    id_type id = slots[index];
+    if (id == empty_slot) {
+      return index;
+    }
+    if (id != erased_slot && hashes[id] == hashed && lengths[id] == size &&
+        std::memcmp(text.data() + offsets[id], uri, size) == 0) {
+      return index;
+    }
+  }
+}
+
+UriTable::id_type UriTable::find(const char* uri, size_t size) const
+{
+  if (slots.empty()) {
+    return npos;
+  }
+  id_type id = slots[slot(uri, size, hash(uri, size))];
+  return id == empty_slot ? npos : id;
+}
+
+UriTable::id_type UriTable::intern(const char* uri, size_t size)
+{
+  // at most half of the slots are used, erased ones included
+  if ((used_slots + 1) * 2 > slots.size()) {
+    rehash(std::max<size_t>(16, (live + 1) * 4));
+  }
+  std::uint32_t hashed = hash(uri, size);
+  size_t index = slot(uri, size, hashed);
+  if (slots[index] != empty_slot) {
+    return slots[index];
+  }
+  if (text.size() + size > erased) {
+    throw std::length_error("uri table is full");
+  }
+  id_type id;
+  if (unused.empty()) {
+    id = end();
+    offsets.push_back(0);
+    lengths.push_back(0);
+    hashes.push_back(0);
+  } else {
+    id = unused.back();
+    unused.pop_back();
+  }
+  offsets[id] = static_cast<std::uint32_t>(text.size());
+  lengths[id] = static_cast<std::uint32_t>(size);
+  hashes[id] = hashed;
+  text.insert(text.end(), uri, uri + size);
+  slots[index] = id;
+  ++used_slots;
+  ++live;
+  return id;
+}
+
+void UriTable::erase(id_type id)
+{
+  if (!contains(id)) {
+    return;
+  }
+  size_t index = slot(data(id), size(id), hashes[id]);
+  // a tombstone, so the probes that passed this slot still find their uris
+  slots[index] = erased_slot;
+  erased_bytes += lengths[id];
+  lengths[id] = erased;
+  unused.push_back(id);
+  --live;
+  if (erased_bytes > 64 * 1024 && erased_bytes > text.size() / 2) {
+    compact();
+  }
+}
+
+void UriTable::clear()
+{
+  text.clear();
+  offsets.clear();
+  lengths.clear();
+  hashes.clear();
+  slots.clear();
+  unused.clear();
+  live = 0;
+  used_slots = 0;
+  erased_bytes = 0;
+}
+
+void UriTable::rehash(size_t slotCount)
+{
+  size_t count = 16;
+  while (count < slotCount) {
+    count *= 2;
+  }
+  slots.assign(count, empty_slot);
+  used_slots = 0;
+  size_t mask = count - 1;
+  for (id_type id = 0; id < end(); ++id) {
+    if (lengths[id] == erased) {
+      continue;
+    }
+    size_t index = hashes[id] & mask;
+    while (slots[index] != empty_slot) {
+      index = (index + 1) & mask;
+    }
+    slots[index] = id;
+    ++used_slots;
+  }
+}
+
+void UriTable::compact()
+{
+  std::vector<char> compacted;
+  compacted.reserve(text.size() - erased_bytes);
+  for (id_type id = 0; id < end(); ++id) {
+    if (lengths[id] == erased) {
+      continue;
+    }
+    std::uint32_t offset = static_cast<std::uint32_t>(compacted.size());
+    compacted.insert(compacted.end(), data(id), data(id) + size(id));
+    offsets[id] = offset;
+  }
+  text.swap(compacted);
+  erased_bytes = 0;
+}
+
+size_t UriTable::bytes() const
+{
+  return text.capacity() +
+    (offsets.capacity() + lengths.capacity() + hashes.capacity()) * sizeof(std::uint32_t) +
+    (slots.capacity() + unused.capacity()) * sizeof(id_type);
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___URI_TABLE_INC__
+#define ___URI_TABLE_INC__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// interns uris, each under a small id. the text of every uri is kept in
+// one arena and looked up through an open addressed index of ids, so a
+// uri costs its length plus a few words rather than a string and a hash
+// node of its own. state kept per uri can live in arrays indexed by id.
+//
+// the ids of erased uris are reused. the arena is compacted once more
+// of it is erased than is live, ids are not changed by that.
+class UriTable
+{
+public:
+  typedef std::uint32_t id_type;
+  static const id_type npos = 0xffffffff;
+
+  UriTable();
+
+  // the id of uri, interned when it is not here already
+  id_type intern(const char* uri, size_t size);
+  id_type intern(const std::string& uri) { return intern(uri.data(), uri.size()); }
+
+  // the id of uri, or npos
+  id_type find(const char* uri, size_t size) const;
+  id_type find(const std::string& uri) const { return find(uri.data(), uri.size()); }
+
+  void erase(id_type id);
+  void clear();
+
+  // the ids in use are below end() and contained
+  id_type end() const { return static_cast<id_type>(lengths.size()); }
+  bool contains(id_type id) const { return id < end() && lengths[id] != erased; }
+
+  // the text of id, valid until the next intern or erase
+  const char* data(id_type id) const { return text.data() + offsets[id]; }
+  size_t size(id_type id) const { return lengths[id]; }
+  std::string str(id_type id) const { return std::string(data(id), size(id)); }
+
+  // the uris interned
+  size_t size() const { return live; }
+  // the memory held
+  size_t bytes() const;
+
+private:
+  static const std::uint32_t erased = 0xffffffff;
+  static const id_type empty_slot = 0xffffffff;
+  static const id_type erased_slot = 0xfffffffe;
+
+  static std::uint32_t hash(const char* uri, size_t size);
+  size_t slot(const char* uri, size_t size, std::uint32_t hashed) const;
+  void rehash(size_t slotCount);
+  void compact();
+
+  // the uris, one after another
+  std::vector<char> text;
+  // per id
+  std::vector<std::uint32_t> offsets;
+  std::vector<std::uint32_t> lengths;
+  std::vector<std::uint32_t> hashes;
+  // ids, or empty_slot or erased_slot, a power of two of them
+  std::vector<id_type> slots;
+  std::vector<id_type> unused;
+  size_t live;
+  size_t used_slots;
+  size_t erased_bytes;
+};
+
+#endif  // ___URI_TABLE_INC__
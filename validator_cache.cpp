@@ -0,0 +1,103 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "validator_cache.hpp"
+#include <cstdint>
+#include <cstdlib>
+
+void ValidatorCache::apply(const std::string& uri, network::http::client::request& request)
+{
+  std::vector<std::pair<std::string, std::string>> headers;
+  apply(uri, headers);
+  for (auto& header : headers) {
+    request << network::header(header.first, header.second);
+  }
+}
+
+void ValidatorCache::apply(const std::string& uri, std::vector<std::pair<std::string, std::string>>& headers)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  auto found = validators.find(uri);
+  if (found == validators.end()) {
+    return;
+  }
+  const Validators& known = found->second;
+  if (!known.etag.empty()) {
+    headers.push_back(std::make_pair("If-None-Match", known.etag));
+  }
+  if (!known.last_modified.empty()) {
+    headers.push_back(std::make_pair("If-Modified-Since", known.last_modified));
+  }
+  if (!known.etag.empty() || !known.last_modified.empty()) {
+    ++counters.conditional;
+  }
+}
+
+bool ValidatorCache::not_modified(const std::string& uri, const network::http::client::response& response)
+{
+  std::uint16_t code = status(response);
+  if (code == 304) {
+    std::unique_lock<std::mutex> guard(lock);
+    ++counters.not_modified;
+    auto found = validators.find(uri);
+    if (found != validators.end()) {
+      counters.bytes_saved += found->second.length;
+    }
+    return true;
+  }
+  return false;
+}
+
+void ValidatorCache::commit(const std::string& uri, const network::http::client::response& response)
+{
+  if (status(response) != 200) {
+    return;
+  }
+
+  Validators fresh;
+  response.get_headers(
+    "ETag",
+    [&](std::string const& name, std::string const& value){
+      fresh.etag = value;});
+  response.get_headers(
+    "Last-Modified",
+    [&](std::string const& name, std::string const& value){
+      fresh.last_modified = value;});
+  response.get_headers(
+    "Content-Length",
+    [&](std::string const& name, std::string const& value){
+      fresh.length = std::strtoul(value.c_str(), nullptr, 10);});
+
+  std::unique_lock<std::mutex> guard(lock);
+  ++counters.modified;
+  if (fresh.etag.empty() && fresh.last_modified.empty()) {
+    validators.erase(uri);
+  } else {
+    validators[uri] = std::move(fresh);
+  }
+}
+
+ValidatorCache::Stats ValidatorCache::stats() const
+{
+  std::unique_lock<std::mutex> guard(lock);
+  return counters;
+}
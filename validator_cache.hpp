@@ -0,0 +1,82 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___VALIDATOR_CACHE_INC__
+#define ___VALIDATOR_CACHE_INC__
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <network/http/client.hpp>
+
+// remembers the ETag and Last-Modified validators of the last full
+// response for each uri, so that the next poll can be a conditional
+// GET that the server answers with "304 Not Modified" and no body.
+class ValidatorCache
+{
+public:
+  struct Stats
+  {
+    Stats() : conditional(0), not_modified(0), modified(0), bytes_saved(0) {}
+    // requests sent with If-None-Match or If-Modified-Since
+    size_t conditional;
+    // 304 responses, which are not emitted downstream
+    size_t not_modified;
+    // full responses whose validators were stored
+    size_t modified;
+    // Content-Length of the last full response, summed over each 304
+    size_t bytes_saved;
+  };
+
+  // adds the conditional headers for uri to request, if any are known.
+  void apply(const std::string& uri, network::http::client::request& request);
+  void apply(const std::string& uri, std::vector<std::pair<std::string, std::string>>& headers);
+
+  // returns true when response is a 304 for uri. only needs the
+  // status line and headers.
+  bool not_modified(const std::string& uri, const network::http::client::response& response);
+
+  // stores the validators of response, a 200 for uri, for the next
+  // apply(). called once the body has been received, decoded and
+  // parsed, so a body that was cut short or could not be read is not
+  // answered with a 304 on the next poll.
+  void commit(const std::string& uri, const network::http::client::response& response);
+
+  Stats stats() const;
+
+private:
+  struct Validators
+  {
+    Validators() : length(0) {}
+    std::string etag;
+    std::string last_modified;
+    size_t length;
+  };
+
+  mutable std::mutex lock;
+  std::unordered_map<std::string, Validators> validators;
+  Stats counters;
+};
+
+#endif  // ___VALIDATOR_CACHE_INC__
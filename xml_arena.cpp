@@ -0,0 +1,295 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+
+#include "xml_arena.hpp"
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+
+namespace {
+
+const size_t page_size = 4096;
+// blocks of 1 to classes pages
+const size_t classes = 256;
+const size_t chunk_size = 4 * 1024 * 1024;
+const size_t huge_page_size = 2 * 1024 * 1024;
+const size_t thread_cache_limit = 8 * 1024 * 1024;
+
+// before the memory handed out, keeps it aligned for rapidxml
+struct Header
+{
+  size_t size;
+  size_t reserved;
+};
+
+// a free block, in place of its header
+struct Free
+{
+  Free* next;
+};
+
+std::atomic<bool> huge(false);
+std::atomic<bool> started(false);
+
+struct Counters
+{
+  Counters()
+    : reserved(0), in_use(0), high_water(0)
+    , fresh(0), cached(0), central(0)
+    , locks(0), contended(0)
+  {}
+  std::atomic<size_t> reserved;
+  std::atomic<size_t> in_use;
+  std::atomic<size_t> high_water;
+  std::atomic<size_t> fresh;
+  std::atomic<size_t> cached;
+  std::atomic<size_t> central;
+  std::atomic<size_t> locks;
+  std::atomic<size_t> contended;
+};
+
+Counters& counters()
+{
+  static Counters counters;
+  return counters;
+}
+
+// the blocks given back by the thread caches. never destroyed, blocks
+// may be freed into it while the program exits.
+struct Central
+{
+  Central()
+  {
+    for (auto& list : lists) {
+      list = nullptr;
+    }
+  }
+  std::mutex lock;
+  Free* lists[classes];
+};
+
+Central& central()
+{
+  static Central* central = new Central();
+  return *central;
+}
+
+std::unique_lock<std::mutex> lock_central()
+{
+  auto& c = counters();
+  ++c.locks;
+  std::unique_lock<std::mutex> guard(central().lock, std::try_to_lock);
+  if (!guard.owns_lock()) {
+    ++c.contended;
+    guard.lock();
+  }
+  return guard;
+}
+
+char* map(size_t size)
+{
+  bool use_huge = huge && size >= huge_page_size;
+  size_t mapped = use_huge ? size + huge_page_size : size;
+  void* memory = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  char* begin = static_cast<char*>(memory);
+  if (use_huge) {
+    // trimmed to whole huge pages
+    char* aligned = reinterpret_cast<char*>((reinterpret_cast<size_t>(begin) + huge_page_size - 1) & ~(huge_page_size - 1));
+    if (aligned != begin) {
+      ::munmap(begin, aligned - begin);
+    }
+    if (aligned + size != begin + mapped) {
+      ::munmap(aligned + size, begin + mapped - (aligned + size));
+    }
+    begin = aligned;
+    ::madvise(begin, size, MADV_HUGEPAGE);
+  }
+  counters().reserved += size;
+  return begin;
+}
+
+void used(long long delta)
+{
+  auto& c = counters();
+  size_t now = c.in_use += delta;
+  size_t high = c.high_water;
+  while (now > high && !c.high_water.compare_exchange_weak(high, now)) {
+  }
+}
+
+// the blocks freed on this thread, and the chunk it carves from
+struct ThreadCache
+{
+  ThreadCache() : bytes(0), next(nullptr), end(nullptr)
+  {
+    for (auto& list : lists) {
+      list = nullptr;
+    }
+    state = alive;
+  }
+
+  ~ThreadCache()
+  {
+    state = gone;
+    auto guard = lock_central();
+    for (size_t index = 0; index < classes; ++index) {
+      while (lists[index]) {
+        Free* block = lists[index];
+        lists[index] = block->next;
+        block->next = central().lists[index];
+        central().lists[index] = block;
+      }
+    }
+    // the rest of the chunk is lost, it stays in reserved
+  }
+
+  char* carve(size_t size)
+  {
+    if (size_t(end - next) < size) {
+      next = map(chunk_size);
+      end = next + chunk_size;
+    }
+    char* block = next;
+    next += size;
+    return block;
+  }
+
+  size_t bytes;
+  Free* lists[classes];
+  char* next;
+  char* end;
+
+  // a free after the cache of the thread is gone, while the thread
+  // exits, goes to the central cache
+  enum State { unused, alive, gone };
+  static thread_local State state;
+};
+
+thread_local ThreadCache::State ThreadCache::state = ThreadCache::unused;
+
+ThreadCache& thread_cache()
+{
+  thread_local ThreadCache cache;
+  return cache;
+}
+
+}
+
+void xml_arena_use_huge_pages(bool use)
+{
+  if (!started) {
+    huge = use;
+  }
+}
+
+void* xml_arena_alloc(std::size_t size)
+{
+  started = true;
+  auto& c = counters();
+  size_t pages = (size + sizeof(Header) + page_size - 1) / page_size;
+  size_t bytes = pages * page_size;
+  char* block = nullptr;
+  if (pages > classes) {
+    block = map(bytes);
+    ++c.fresh;
+  } else {
+    size_t index = pages - 1;
+    auto& cache = thread_cache();
+    if (cache.lists[index]) {
+      Free* free = cache.lists[index];
+      cache.lists[index] = free->next;
+      cache.bytes -= bytes;
+      block = reinterpret_cast<char*>(free);
+      ++c.cached;
+    } else {
+      {
+        auto guard = lock_central();
+        Free* free = central().lists[index];
+        if (free) {
+          central().lists[index] = free->next;
+          block = reinterpret_cast<char*>(free);
+        }
+      }
+      if (block) {
+        ++c.central;
+      } else {
+        block = cache.carve(bytes);
+        ++c.fresh;
+      }
+    }
+  }
+  used(bytes);
+  Header* header = reinterpret_cast<Header*>(block);
+  header->size = bytes;
+  return header + 1;
+}
+
+void xml_arena_free(void* memory)
+{
+  if (!memory) {
+    return;
+  }
+  Header* header = static_cast<Header*>(memory) - 1;
+  size_t bytes = header->size;
+  size_t pages = bytes / page_size;
+  used(-static_cast<long long>(bytes));
+  Free* block = reinterpret_cast<Free*>(header);
+  if (pages > classes) {
+    ::munmap(block, bytes);
+    counters().reserved -= bytes;
+    return;
+  }
+  size_t index = pages - 1;
+  if (ThreadCache::state != ThreadCache::gone) {
+    auto& cache = thread_cache();
+    if (cache.bytes + bytes <= thread_cache_limit) {
+      block->next = cache.lists[index];
+      cache.lists[index] = block;
+      cache.bytes += bytes;
+      return;
+    }
+  }
+  auto guard = lock_central();
+  block->next = central().lists[index];
+  central().lists[index] = block;
+}
+
+XmlArenaStats xml_arena_stats()
+{
+  auto& c = counters();
+  XmlArenaStats stats;
+  stats.reserved = c.reserved;
+  stats.in_use = c.in_use;
+  stats.high_water = c.high_water;
+  stats.fresh = c.fresh;
+  stats.cached = c.cached;
+  stats.central = c.central;
+  stats.locks = c.locks;
+  stats.contended = c.contended;
+  stats.huge_pages = huge;
+  return stats;
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2013, Kirk Shoop (kirk.shoop@gmail.com)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, 
+//  are permitted provided that the following conditions are met:
+//
+//  - Redistributions of source code must retain the above copyright notice, 
+//      this list of conditions and the following disclaimer.
+//  - Redistributions in binary form must reproduce the above copyright notice, 
+//      this list of conditions and the following disclaimer in the documentation 
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+#ifndef ___XML_ARENA_INC__
+#define ___XML_ARENA_INC__
+
+#include <cstddef>
+
+// the allocator of the dynamic blocks of the xml documents, for
+// rapidxml's memory_pool::set_allocator. blocks are sized in classes of
+// whole pages up to 1 MB and carved from chunks of 4 MB mapped from the
+// system. each thread keeps the blocks it frees in a cache of its own
+// and allocates from it without a lock, up to 8 MB. the rest are shared
+// through a central cache that takes a lock. larger blocks are mapped
+// and unmapped one by one. the chunks are kept for the life of the
+// process, their blocks are only ever reused.
+
+// maps the chunks, and the blocks of 2 MB and more, on huge pages where
+// the system allows it. only takes effect before the first allocation.
+void xml_arena_use_huge_pages(bool use);
+
+void* xml_arena_alloc(std::size_t size);
+void xml_arena_free(void* memory);
+
+struct XmlArenaStats
+{
+  XmlArenaStats()
+    : reserved(0), in_use(0), high_water(0)
+    , fresh(0), cached(0), central(0)
+    , locks(0), contended(0), huge_pages(false)
+  {}
+  // mapped from the system, allocated now, and the most allocated at once
+  size_t reserved;
+  size_t in_use;
+  size_t high_water;
+  // allocations carved from a chunk or mapped, taken from the cache of
+  // the thread, and taken from the central cache
+  size_t fresh;
+  size_t cached;
+  size_t central;
+  // times the central cache was locked, and found locked already
+  size_t locks;
+  size_t contended;
+  bool huge_pages;
+};
+
+XmlArenaStats xml_arena_stats();
+
+#endif  // ___XML_ARENA_INC__